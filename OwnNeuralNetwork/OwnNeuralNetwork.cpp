@@ -4,6 +4,8 @@
 #include <random>
 #include <chrono> // für Zeitmessung
 #include <filesystem>
+#include <utility>
+#include <charconv>
 #include <Eigen/Dense>
 #include <omp.h>
 
@@ -14,6 +16,14 @@
 
 #include "nn_defs.h"
 #include "helpers.h"
+#include "neural_network.h"
+#include "benchmark.h"
+#include "cross_validation.h"
+#include "hyperparameter_search.h"
+#include "checkpoint.h"
+#include "optimizers.h"
+#include "schedules.h"
+#include "epoch_order.h"
 
 namespace fs = std::filesystem;
 
@@ -28,89 +38,6 @@ const fs::path execDirFallback = fs::path("..\\x64\\Release\\");
 const fs::path metaDataFile = fs::path("irisMetaData.txt");
 const fs::path csvDataFile = fs::path("iris.csv");
 
-class NeuralNetwork {
-public:
-    NeuralNetwork(size_t _inputNodes, size_t _hiddenNodes, size_t _outputNodes, decimal _learningRate, 
-        std::function<vector_type(const vector_type&)> _activationHidden = Helpers::sigmoidFunction<vector_type>, 
-        std::function<vector_type(const vector_type&)> _activationOutput = Helpers::sigmoidFunction<vector_type>) :
-        inputNodes{ _inputNodes },
-        hiddenNodes{ _hiddenNodes },
-        outputNodes{ _outputNodes },
-        learningRate{ _learningRate },
-        activationHidden{ _activationHidden },
-        activationOutput{ _activationOutput }
-    {
-        initializeWeights();
-    }
-
-    void initializeWeights() {
-        // build wInputHidden and wHiddenOutput as random matrices with normally distributed entries
-        std::random_device rd{};
-        std::mt19937 gen{ rd() };
-        std::normal_distribution<decimal> distWInputHidden(0.0f, std::pow(inputNodes, -0.5f));
-        std::normal_distribution<decimal> distWHiddenOutput(0.0f, std::pow(hiddenNodes, -0.5f));
-        wInputHidden = matrix_type::NullaryExpr(hiddenNodes, inputNodes, [&]() {return distWInputHidden(gen); });
-        wHiddenOutput = matrix_type::NullaryExpr(outputNodes, hiddenNodes, [&]() {return distWHiddenOutput(gen); });
-    }
-    
-    [[nodiscard]] vector_type query(const vector_type& _inputs) {
-        // calculate signals into hidden layer
-        matrix_type hiddenInputs = wInputHidden * _inputs;
-        // calculate the signals emerging from hidden layer
-        vector_type hiddenOutputs = activationHidden(hiddenInputs);
-
-        // calculate signals into final output layer
-        matrix_type finalInputs = wHiddenOutput * hiddenOutputs;
-        // calculate the signals emerging from final output layer
-        vector_type finalOutputs = activationOutput(finalInputs);
-
-        return std::move(finalOutputs);
-    }
-
-    void train(const vector_type& _inputs, const vector_type& _targets) {
-
-        // calculate signals into hidden layer
-        matrix_type hiddenInputs = wInputHidden * _inputs;
-        // calculate the signals emerging from hidden layer
-        vector_type hiddenOutputs = activationHidden(hiddenInputs);
-
-        // calculate signals into final output layer
-        matrix_type finalInputs = wHiddenOutput * hiddenOutputs;
-        // calculate the signals emerging from final output layer
-        vector_type finalOutputs = activationHidden(finalInputs);
-
-        // output layer error is the(target - actual)
-        matrix_type outputErrors = _targets - finalOutputs;
-        // hidden layer error is the output_errors, split by weights, recombined at hidden nodes
-		// auto hiddenErrors is of Eigen type: Eigen::MatrixXd
-        matrix_type hiddenErrors = wHiddenOutput.transpose() * outputErrors;
-
-        // update the weights for the links between the hidden and output layers
-        wHiddenOutput += learningRate * outputErrors.cwiseProduct(finalOutputs.cwiseProduct(vector_type::Constant(outputNodes, 1.0) - finalOutputs)) * hiddenOutputs.transpose();
-
-        // update the weights for the links between the input and hidden layers
-        wInputHidden += learningRate * hiddenErrors.cwiseProduct(hiddenOutputs.cwiseProduct(vector_type::Constant(hiddenNodes, 1.0) - hiddenOutputs)) * _inputs.transpose();
-    }
-
-    [[nodiscard]] matrix_type getWInputHidden() const {
-        return wInputHidden;
-    }
-
-    [[nodiscard]] matrix_type getWHiddenOutput() const {
-        return wHiddenOutput;
-    }
-
-private:
-    size_t inputNodes = 0;
-    size_t hiddenNodes = 0;
-    size_t outputNodes = 0;
-    decimal learningRate = 0.0;
-    matrix_type wInputHidden;
-    matrix_type wHiddenOutput;
-    std::function<vector_type(vector_type)> activationHidden;
-    std::function<vector_type(vector_type)> activationOutput;
-};
-
 // method print(const std::string& s)
 // that prints s to the console
 void print(const std::string& s) {
@@ -121,8 +48,86 @@ void print(const std::string& s) {
     return fs::weakly_canonical(fs::current_path() / (fs::exists(execDir / file) ? execDir : execDirFallback) / file);
 }
 
-int main()
+// the directory of the running program, from its path _argv0; the working directory if it has none
+[[nodiscard]] fs::path getExecutableDir(const char* _argv0) {
+    const fs::path dir = fs::path(_argv0 != nullptr ? _argv0 : "").parent_path();
+    return dir.empty() ? fs::current_path() : fs::absolute(dir);
+}
+
+int main(int argc, char* argv[])
 {
+#ifdef _DEBUG
+    // the vectorized activation kernels have to stay within their documented error bounds
+    assert(Helpers::getMaxUlpError<decimal>(Helpers::sigmoidKernel<decimal>, [](decimal x) { return Helpers::sigmoidFunction<decimal>(x); }) <= 4);
+    assert(Helpers::getMaxUlpError<decimal>(Helpers::tanhKernel<decimal>, [](decimal x) { return std::tanh(x); }) <= 3);
+    // in float against the double reference, so the reference itself is correctly rounded
+    assert(Helpers::getMaxUlpError<float>(Helpers::sigmoidKernel<float>, [](float x) { return static_cast<float>(Helpers::sigmoidFunction<double>(x)); }) <= 4);
+    assert(Helpers::getMaxUlpError<float>(Helpers::tanhKernel<float>, [](float x) { return static_cast<float>(std::tanh(static_cast<double>(x))); }) <= 4);
+#endif
+
+    const std::vector<std::string> args(argv + 1, argv + argc);
+    auto hasOption = [&args](const std::string& _option) { return std::find(args.begin(), args.end(), _option) != args.end(); };
+    // the argument following _option, empty if there is none
+    auto getOptionValue = [&args](const std::string& _option) {
+        auto it = std::find(args.begin(), args.end(), _option);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : std::string();
+    };
+    // reads the number following _option into _value, false if it is missing or not a number
+    auto getOptionNumber = [&getOptionValue](const std::string& _option, uint64_t& _value) {
+        const std::string value = getOptionValue(_option);
+        const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), _value);
+        return !value.empty() && ec == std::errc() && ptr == value.data() + value.size();
+    };
+
+    // --seed N: the one seed of the run, the split, the initial weights and the folds are derived from it,
+    // so two runs with the same seed and options train the same networks
+    uint64_t seed = 42;
+    if (hasOption("--seed") && !getOptionNumber("--seed", seed)) {
+        std::cout << "Invalid seed " << getOptionValue("--seed") << std::endl;
+        return 1;
+    }
+    std::cout << "Seed: " << seed << std::endl;
+
+    // --init lecun|xavier|he: initialization of the weights
+    Initializers::Type initialization = Initializers::Type::LeCun;
+    if (hasOption("--init")) {
+        try {
+            initialization = Initializers::getType(getOptionValue("--init"));
+        }
+        catch (const std::invalid_argument& ex) {
+            std::cout << ex.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // --optimizer sgd|momentum|nesterov|rmsprop|adam|adamw: update rule of the networks trained below
+    Optimizers::Settings optimizerSettings;
+    if (hasOption("--optimizer")) {
+        try {
+            optimizerSettings.type = Optimizers::getType(getOptionValue("--optimizer"));
+        }
+        catch (const std::invalid_argument& ex) {
+            std::cout << ex.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // --schedule constant|step|exponential|cosine|onecycle|plateau: learning rate schedule of the epoch loops,
+    // counted in epochs or, with --schedule-per-step, in mini-batches
+    Schedules::Settings scheduleSettings;
+    if (hasOption("--schedule")) {
+        try {
+            scheduleSettings.type = Schedules::getType(getOptionValue("--schedule"));
+        }
+        catch (const std::invalid_argument& ex) {
+            std::cout << ex.what() << std::endl;
+            return 1;
+        }
+    }
+    if (hasOption("--schedule-per-step")) {
+        scheduleSettings.unit = Schedules::Unit::Step;
+    }
+
     // Start der Zeitmessung
     auto start = std::chrono::high_resolution_clock::now();
 
@@ -142,35 +147,113 @@ int main()
 		return 1;
     }
 
-    std::vector<std::vector<std::string>> content = getCsvContent(csvDataFileFullPath.string());
-
     DataTableMetaData dataTableMetaData;
     dataTableMetaData.setMetaData(metaDataFileFullPath.string());
 
     DataTable::DataTable dataTable;
     dataTable.setMetaData(dataTableMetaData);
-    dataTable.setData(content);
+    // the binary cache next to the csv file is mapped if it is up to date, otherwise the csv file is parsed and cached;
+    // --no-cache always parses the csv file
+    const std::string cacheFile = csvDataFileFullPath.string() + ".cache";
+    const bool useCache = !hasOption("--no-cache");
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    bool fromCache = false;
+    if (useCache) {
+        try {
+            fromCache = dataTable.readCache(cacheFile, csvDataFileFullPath.string());
+        }
+        catch (const std::runtime_error& ex) {
+            // a broken cache is replaced: the csv file is parsed and the cache written anew below
+            std::cout << ex.what() << std::endl;
+        }
+    }
+    try {
+        if (!fromCache) {
+            dataTable.readCsvParallel(csvDataFileFullPath.string(), Helpers::getMaxThreads());
+        }
+    }
+    catch (const std::runtime_error& ex) {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+    auto loadEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "Loaded " << dataTable.getNumberOfDatasets() << " datasets from " << (fromCache ? "cache" : "csv") << " in "
+        << std::chrono::duration_cast<std::chrono::microseconds>(loadEnd - loadStart).count() << " us" << std::endl;
+    if (useCache && !fromCache) {
+        try {
+            dataTable.writeCache(cacheFile, csvDataFileFullPath.string());
+        }
+        catch (const std::runtime_error& ex) {
+            // the run does not depend on the cache
+            std::cout << ex.what() << std::endl;
+        }
+    }
+
+    // --benchmark-csv: throughput of the parallel csv reader from 1 to all cores on a generated file
+    if (hasOption("--benchmark-csv")) {
+        Benchmark::compareCsvThreads(2000000, Helpers::getMaxThreads());
+        return 0;
+    }
+
+    // --cross-validation: stratified 5-fold cross-validation of the network below, the folds are trained in parallel;
+    // every fold scales the features with the statistics of its own training part
+    if (hasOption("--cross-validation")) {
+        CrossValidation::Settings settings;
+        settings.nodes = { dataTable.getActiveFeatures().size(), 4, dataTable.getNumberOfClasses() };
+        settings.optimizer = optimizerSettings;
+        settings.schedule = scheduleSettings;
+        settings.initialization = initialization;
+        CrossValidation::print(CrossValidation::run(dataTable, 5, settings, seed, Helpers::getMaxThreads()));
+        return 0;
+    }
 
+    // stratified, the test part keeps the class shares of the data
     Splitter splitter;
-    splitter.reset(dataTable.getNumberOfDatasets());
-    splitter.pickIdcsRandomly(30, dataTable.getTargetNames().size());
-    splitter.removeIdcs();
+    splitter.pickIdcsStratified(dataTable.getLabels(), 30, seed);
     
     DataTable::DataTable trainDataTable = dataTable.getTrainDataTable(splitter);
     DataTable::DataTable testDataTable = dataTable.getTestDataTable(splitter);
 
+    // robust scaling with the statistics of the training data, applied in place to both tables
 	for (auto feature : dataTable.getActiveFeatures()) {
 		print("Feature: " + std::to_string(feature));
         auto w = trainDataTable.getNumericDataColumn(feature);
 		auto median = Helpers::getMedian(w);
 		auto iqr = Helpers::getInterquartileRange(w);
-        w = dataTable.getNumericDataColumn(feature);
-        w = Helpers::getRobustScaling(dataTable.getNumericDataColumn(feature), median, iqr);
-        dataTable.setNumericDataColumn(feature, w);
+        trainDataTable.scaleNumericDataColumn(feature, median, iqr);
+        testDataTable.scaleNumericDataColumn(feature, median, iqr);
 	}
 
-    auto nn = NeuralNetwork(4, 4, 3, 0.12);
-    auto nn_ws = nn;
+    // --search-grid, --search-random, --search-halving: hyperparameter search on a stratified validation part of the
+    // training data (the test data stays unseen), the trials run in parallel, the results go to search_results.csv/.json
+    if (hasOption("--search-grid") || hasOption("--search-random") || hasOption("--search-halving")) {
+        Splitter validationSplitter;
+        validationSplitter.pickIdcsStratified(trainDataTable.getLabels(), trainDataTable.getNumberOfDatasets() / 5, seed);
+        const auto& [searchTrainIdcs, validationIdcs] = validationSplitter.getIdcs();
+        const HyperparameterSearch::SearchSpace space;
+        const size_t searchEpochs = 250;
+        const size_t searchPatience = 10;
+        std::vector<HyperparameterSearch::TrialResult> results;
+        if (hasOption("--search-grid")) {
+            results = HyperparameterSearch::run(HyperparameterSearch::getGrid(space), trainDataTable, searchTrainIdcs, validationIdcs, searchEpochs, searchPatience, seed, Helpers::getMaxThreads());
+        }
+        else if (hasOption("--search-random")) {
+            results = HyperparameterSearch::run(HyperparameterSearch::getRandomTrials(space, 40, seed), trainDataTable, searchTrainIdcs, validationIdcs, searchEpochs, searchPatience, seed, Helpers::getMaxThreads());
+        }
+        else {
+            results = HyperparameterSearch::runSuccessiveHalving(HyperparameterSearch::getRandomTrials(space, 81, seed), trainDataTable, searchTrainIdcs, validationIdcs, searchEpochs, searchPatience, 3, seed, Helpers::getMaxThreads());
+        }
+        HyperparameterSearch::print(results, 10);
+        HyperparameterSearch::writeCsv(results, "search_results.csv");
+        HyperparameterSearch::writeJson(results, "search_results.json");
+        return 0;
+    }
+
+    // one input per active feature and one output per class found in the data
+    const std::vector<size_t> nodes = { dataTable.getActiveFeatures().size(), 4, dataTable.getNumberOfClasses() };
+    // softmax output trained on the cross-entropy of the class labels, so no target matrix is needed for training
+    auto nn = NeuralNetwork<decimal, Activations::Sigmoid, Activations::SoftmaxCrossEntropy>(nodes, 0.12, Helpers::deriveSeed(seed, 0), initialization);
+    nn.setOptimizer(optimizerSettings);
 
     size_t test_data_size = testDataTable.getNumberOfDatasets();
 	// std::cout << testDataTable.getNumberOfDatasets() << std::endl;
@@ -180,59 +263,173 @@ int main()
     const uint8_t patience_const = 10;
     uint8_t patience = patience_const;
 
-    for (size_t epoch = 0; epoch < epochs; ++epoch) {
-        for (size_t j = 0; j < trainDataTable.getNumberOfDatasets(); ++j) {
-            vector_type train_inputs = Helpers::convertVectorElements(trainDataTable.getNumericData()[j]);
-            vector_type train_targets = Helpers::getEncoding(trainDataTable.getTargets()[j]);
-            nn_ws.train(train_inputs, train_targets);
-        }
+    // samples per weight update, 1 reproduces the plain per-sample training
+    const Eigen::Index batch_size = 1;
+
+    // the numeric data and the encoded targets of the tables are used in place
+    const auto all_train_inputs = std::as_const(trainDataTable).getNumericData();
+    const matrix_type& all_train_targets = trainDataTable.getTargetMatrix();
+    const std::span<const uint32_t> all_train_labels = trainDataTable.getLabels();
+    const Eigen::Index train_data_size = all_train_inputs.cols();
+
+    const auto all_test_inputs = std::as_const(testDataTable).getNumericData();
+    const std::vector<Eigen::Index> test_classes(testDataTable.getLabels().begin(), testDataTable.getLabels().end());
+    // reused by queryBatch in every epoch
+    matrix_type predicted_test_outputs(nodes.back(), test_data_size);
+    std::vector<Eigen::Index> predicted_test_classes(test_data_size);
+
+    // --benchmark-precision: compares float and double training on iris.csv and a larger synthetic dataset
+    if (hasOption("--benchmark-precision")) {
+        Benchmark::Dataset iris;
+        iris.name = csvDataFile.string();
+        iris.trainInputs = all_train_inputs;
+        iris.trainTargets = all_train_targets;
+        iris.testInputs = all_test_inputs;
+        iris.testClasses = test_classes;
+        iris.nodes = nodes;
+        iris.epochs = epochs;
+        iris.batchSize = batch_size;
+        iris.learningRate = 0.12;
+        iris.seed = seed;
+        Benchmark::comparePrecision({ iris, Benchmark::makeSyntheticDataset(64, 10, 20000, 5000, seed) });
+        return 0;
+    }
 
-        std::vector<vector_type> vector_predicted_test_targets(test_data_size);
-        std::vector<vector_type> vector_test_targets(test_data_size);      
+    // --benchmark-threads: scaling of the data-parallel mini-batch training from 1 to all cores
+    if (hasOption("--benchmark-threads")) {
+        Benchmark::Dataset synthetic = Benchmark::makeSyntheticDataset(64, 10, 20000, 5000, seed);
+        synthetic.batchSize = 256;
+        synthetic.learningRate = 2.0;
+        Benchmark::compareThreads(synthetic, Helpers::getMaxThreads());
+        return 0;
+    }
 
-        for (size_t j = 0; j < test_data_size; ++j) {
-            vector_type test_inputs = Helpers::convertVectorElements(testDataTable.getNumericData()[j]);
-            vector_type test_targets = Helpers::getEncoding(testDataTable.getTargets()[j]);
+    // --benchmark-hogwild: lock-free asynchronous SGD against the sequential train loop
+    if (hasOption("--benchmark-hogwild")) {
+        Benchmark::Dataset synthetic = Benchmark::makeSyntheticDataset(64, 10, 20000, 5000, seed);
+        synthetic.epochs = 3;
+        synthetic.learningRate = 0.1;
+        Benchmark::compareHogwild(synthetic, Helpers::getMaxThreads());
+        return 0;
+    }
 
-            vector_type predicted_test_targets = nn_ws.query(test_inputs);
+    // --benchmark-stream: training streamed from disk with a prefetch thread against training in memory
+    if (hasOption("--benchmark-stream")) {
+        Benchmark::Dataset synthetic = Benchmark::makeSyntheticDataset(64, 10, 20000, 5000, seed);
+        synthetic.epochs = 3;
+        Benchmark::compareStreaming(synthetic, 4096, 1 << 16);
+        return 0;
+    }
 
-            // round to next int
-            predicted_test_targets = predicted_test_targets.unaryExpr([](double v) { return std::round(v); });
-            test_targets = test_targets.unaryExpr([](double v) { return std::round(v); });
+    // --load-model FILE: training continues from the weights of a checkpoint written by an earlier run
+    if (hasOption("--load-model")) {
+        const std::string loadFile = getOptionValue("--load-model");
+        try {
+            Checkpoint::Snapshot<decimal> snapshot;
+            if (!Checkpoint::load(loadFile, nn, snapshot)) {
+                std::cout << "No model for this network in " << loadFile << std::endl;
+                return 1;
+            }
+            std::cout << "Loaded model " << loadFile << " of epoch " << snapshot.epoch << ", accuracy: " << snapshot.accuracy << std::endl;
+        }
+        catch (const std::runtime_error& ex) {
+            std::cout << ex.what() << std::endl;
+            return 1;
+        }
+    }
 
-            vector_predicted_test_targets[j] = predicted_test_targets;
-            vector_test_targets[j] = test_targets;
+    // the best network is kept in memory and written on a background thread to --checkpoint FILE,
+    // by default to <csv file>.model next to the executable, the data directory is only read;
+    // --no-checkpoint keeps it in memory only
+    std::string modelFile;
+    if (!hasOption("--no-checkpoint")) {
+        modelFile = hasOption("--checkpoint") ? getOptionValue("--checkpoint")
+            : (getExecutableDir(argv[0]) / csvDataFile).string() + ".model";
+        if (modelFile.empty()) {
+            std::cout << "Missing checkpoint file" << std::endl;
+            return 1;
+        }
+    }
+    Checkpoint::Manager<decltype(nn)> checkpoint(nn, modelFile);
+
+    Schedules::Schedule schedule(scheduleSettings, nn.getLearningRate(), static_cast<size_t>((train_data_size + batch_size - 1) / batch_size), epochs);
+
+    // every epoch visits the training samples in a new order: only an index array is permuted, the samples of a
+    // mini-batch are gathered into reused buffers and the table is never moved; --no-shuffle keeps the order of the
+    // table (sorted by class in iris.csv), --shuffle-block N shuffles blocks of N neighbouring samples and within them
+    const bool shuffle = !hasOption("--no-shuffle");
+    uint64_t shuffle_block = 0;
+    if (hasOption("--shuffle-block") && !getOptionNumber("--shuffle-block", shuffle_block)) {
+        std::cout << "Invalid block size " << getOptionValue("--shuffle-block") << std::endl;
+        return 1;
+    }
+    EpochOrder order(static_cast<size_t>(train_data_size), Helpers::deriveSeed(seed, 1), static_cast<size_t>(shuffle_block));
+    matrix_type batch_inputs(all_train_inputs.rows(), batch_size);
+    std::vector<uint32_t> batch_labels(batch_size);
 
+    decimal accuracy = -1.0;
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+        bool restarted = false;
+        if (shuffle) {
+            order.shuffle();
+        }
+        for (Eigen::Index j = 0; j < train_data_size; j += batch_size) {
+            nn.setLearningRate(schedule.getRate());
+            const std::span<const uint32_t> idcs = order.getBatch(static_cast<size_t>(j), static_cast<size_t>(batch_size));
+            const Eigen::Index cols = static_cast<Eigen::Index>(idcs.size());
+            gatherColumns<decimal>(all_train_inputs, idcs, batch_inputs);
+            gatherEntries<uint32_t>(all_train_labels, idcs, batch_labels);
+            nn.trainBatch(batch_inputs.leftCols(cols), std::span<const uint32_t>(batch_labels.data(), idcs.size()));
+            if (schedule.onStep()) {
+                restarted = true;
+                nn.resetOptimizer();
+            }
         }
 
+        nn.queryBatch(all_test_inputs, predicted_test_outputs, &predicted_test_classes);
+
         // const size_t buf_size = 2;
         // decimal accuracies[buf_size];
 
-        decimal accuracy = -1.0;
-        size_t corr_predictions = Helpers::getCorrectPredictions(vector_test_targets, vector_predicted_test_targets);
-        decimal current_accuracy = Helpers::getAccuracy(vector_test_targets, vector_predicted_test_targets);
+        size_t corr_predictions = Helpers::getCorrectPredictions(test_classes, predicted_test_classes);
+        decimal current_accuracy = Helpers::getAccuracy(test_classes, predicted_test_classes);
+        // mean cross-entropy of the test samples, computed from the logits
+        const decimal test_loss = nn.getCrossEntropy(all_test_inputs, testDataTable.getLabels()) / static_cast<decimal>(test_data_size);
 
         // Output section
         {
             std::cout << "Epoch: " << epoch << std::endl;
             std::cout << "Correct Predictions: " << corr_predictions << " out of " << test_data_size << std::endl;
             std::cout << "Accuracy: " << current_accuracy << std::endl;
+            std::cout << "Loss: " << test_loss << std::endl;
+            std::cout << "Learning rate: " << nn.getLearningRate() << std::endl;
             std::cout << std::endl;
         }
         
         if (current_accuracy + decimal_eps >= 1.0) {
             patience = patience_const;
             accuracy = current_accuracy;
-            nn = nn_ws;
+            checkpoint.save(nn, epoch, current_accuracy);
             break;
         }
 
         bool is_accuracy_better = epoch == 0 || current_accuracy >= accuracy;
+        // a warm restart starts the optimizer afresh as well
+        if (schedule.onEpoch(is_accuracy_better)) {
+            restarted = true;
+            nn.resetOptimizer();
+        }
 
         if (is_accuracy_better) {
             patience = patience_const;
             accuracy = current_accuracy;
-            nn = nn_ws;
+            checkpoint.save(nn, epoch, current_accuracy);
+            continue;
+        }
+
+        // a warm restart of the schedule gives the network a new chance
+        if (restarted) {
+            patience = patience_const;
             continue;
         }
 
@@ -243,6 +440,18 @@ int main()
         }
     }
 
+    checkpoint.restore(nn);
+    try {
+        checkpoint.flush();
+    }
+    catch (const std::exception& ex) {
+        // the trained network is still in memory
+        std::cout << ex.what() << std::endl;
+    }
+    if (checkpoint.hasSnapshot()) {
+        std::cout << "Best epoch: " << checkpoint.getBest().epoch << ", accuracy: " << checkpoint.getBest().accuracy << std::endl;
+    }
+
     // Endzeitpunkt erfassen
     auto end = std::chrono::high_resolution_clock::now();
 
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cmath>
+
+#include "nn_defs.h"
+#include "helpers.h"
+
+// activation policies for NeuralNetwork, all functions work in place on a whole batch (columns = samples);
+// forward turns the signals into a layer into the signals emerging from it,
+// scaleByDerivative multiplies the errors at the layer outputs by the derivative of the activation,
+// expressed through the layer outputs, so the signals into the layer need not be kept;
+// the scalar type has to be given explicitly, e.g. Sigmoid::forward<float>(signals)
+namespace Activations {
+    // leaves the signals as they are, e.g. for the logits of a layer
+    struct Identity {
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>>) {
+        }
+
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>&, Eigen::Ref<matrix_t<Scalar>>) {
+        }
+    };
+
+    struct Sigmoid {
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>> _signals) {
+            Helpers::sigmoidKernel<Scalar>(_signals);
+        }
+
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>& _outputs, Eigen::Ref<matrix_t<Scalar>> _errors) {
+            _errors.array() *= _outputs.array() * (Scalar(1) - _outputs.array());
+        }
+    };
+
+    struct Tanh {
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>> _signals) {
+            Helpers::tanhKernel<Scalar>(_signals);
+        }
+
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>& _outputs, Eigen::Ref<matrix_t<Scalar>> _errors) {
+            _errors.array() *= Scalar(1) - _outputs.array().square();
+        }
+    };
+
+    struct ReLU {
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>> _signals) {
+            _signals.array() = _signals.array().max(Scalar(0));
+        }
+
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>& _outputs, Eigen::Ref<matrix_t<Scalar>> _errors) {
+            _errors.array() = (_outputs.array() > Scalar(0)).select(_errors.array(), Scalar(0));
+        }
+    };
+
+    struct LeakyReLU {
+        static constexpr double slope = 0.01;
+
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>> _signals) {
+            _signals.array() = _signals.array().max(Scalar(slope) * _signals.array());
+        }
+
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>& _outputs, Eigen::Ref<matrix_t<Scalar>> _errors) {
+            _errors.array() = (_outputs.array() > Scalar(0)).select(_errors.array(), Scalar(slope) * _errors.array());
+        }
+    };
+
+    struct Softmax {
+        template <typename Scalar>
+        static void forward(Eigen::Ref<matrix_t<Scalar>> _signals) {
+            Helpers::softmaxKernel<Scalar>(_signals);
+        }
+
+        // the Jacobian of softmax is diag(y) - y y^T, applied column by column to avoid temporaries
+        template <typename Scalar>
+        static void scaleByDerivative(const Eigen::Ref<const matrix_t<Scalar>>& _outputs, Eigen::Ref<matrix_t<Scalar>> _errors) {
+            for (Eigen::Index j = 0; j < _errors.cols(); ++j) {
+                const Scalar projection = _outputs.col(j).dot(_errors.col(j));
+                _errors.col(j).array() = _outputs.col(j).array() * (_errors.col(j).array() - projection);
+            }
+        }
+    };
+
+    // softmax output layer trained on the categorical cross-entropy -sum(y * log(p)): the gradient of the loss
+    // with respect to the signals into the layer is p - y, so NeuralNetwork takes the output errors directly
+    // from the targets and never applies the Jacobian of Softmax; the targets have to be distributions
+    // (one-hot or smoothed so that every column sums to 1) or are given as class labels
+    struct SoftmaxCrossEntropy : Softmax {
+        static constexpr bool fusedLoss = true;
+    };
+
+    // true for output policies whose loss gradient is computed together with the activation
+    template <typename Activation>
+    constexpr bool hasFusedLoss = requires { requires Activation::fusedLoss; };
+}
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <charconv>
+#include <limits>
+
+#include "nn_defs.h"
+#include "helpers.h"
+#include "neural_network.h"
+#include "data_table.h"
+#include "data_source.h"
+
+namespace Benchmark {
+    // a train/test problem together with the network and training settings to run on it
+    struct Dataset {
+        std::string name;
+        matrix_type trainInputs;
+        matrix_type trainTargets;
+        matrix_type testInputs;
+        std::vector<Eigen::Index> testClasses;
+        std::vector<size_t> nodes;
+        size_t epochs = 0;
+        Eigen::Index batchSize = 1;
+        decimal learningRate = 0.0;
+        // seed of the initial weights, so every trainer of a comparison starts from the same network
+        uint64_t seed = 42;
+    };
+
+    struct Result {
+        long long milliseconds = 0;
+        decimal accuracy = -1.0;
+    };
+
+    // trains a fresh network in precision Scalar on _dataset and scores its test part;
+    // only training and scoring are timed, not the conversion of the data
+    template <typename Scalar>
+    Result trainWithPrecision(const Dataset& _dataset) {
+        const matrix_t<Scalar> trainInputs = _dataset.trainInputs.template cast<Scalar>();
+        const matrix_t<Scalar> trainTargets = _dataset.trainTargets.template cast<Scalar>();
+        const matrix_t<Scalar> testInputs = _dataset.testInputs.template cast<Scalar>();
+        matrix_t<Scalar> testOutputs;
+        std::vector<Eigen::Index> predictedClasses;
+
+        NeuralNetwork<Scalar> nn(_dataset.nodes, static_cast<Scalar>(_dataset.learningRate), _dataset.seed);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t epoch = 0; epoch < _dataset.epochs; ++epoch) {
+            for (Eigen::Index j = 0; j < trainInputs.cols(); j += _dataset.batchSize) {
+                const Eigen::Index cols = std::min(_dataset.batchSize, trainInputs.cols() - j);
+                nn.trainBatch(trainInputs.middleCols(j, cols), trainTargets.middleCols(j, cols));
+            }
+        }
+        nn.queryBatch(testInputs, testOutputs, &predictedClasses);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        Result res;
+        res.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        res.accuracy = Helpers::getAccuracy(_dataset.testClasses, predictedClasses);
+        return res;
+    }
+
+    // _classes gaussian clusters with random centers in _features dimensions,
+    // the targets are encoded with the same 0.01/0.99 levels as DataTable::getTargetMatrix
+    Dataset makeSyntheticDataset(size_t _features, size_t _classes, Eigen::Index _trainSamples, Eigen::Index _testSamples, uint64_t _seed) {
+        std::mt19937_64 gen{ _seed };
+        std::normal_distribution<decimal> noise(0.0, 1.0);
+        std::uniform_int_distribution<Eigen::Index> pickClass(0, static_cast<Eigen::Index>(_classes) - 1);
+        const matrix_type centers = matrix_type::NullaryExpr(_features, _classes, [&]() {return 0.3 * noise(gen); });
+
+        auto makeSamples = [&](Eigen::Index _samples, matrix_type& _inputs, matrix_type& _targets, std::vector<Eigen::Index>& _classIndices) {
+            _inputs.resize(_features, _samples);
+            _targets.setConstant(_classes, _samples, 0.01);
+            _classIndices.resize(_samples);
+            for (Eigen::Index j = 0; j < _samples; ++j) {
+                const Eigen::Index c = pickClass(gen);
+                _inputs.col(j) = centers.col(c) + vector_type::NullaryExpr(_features, [&]() {return noise(gen); });
+                _targets(c, j) = 0.99;
+                _classIndices[j] = c;
+            }
+        };
+
+        Dataset res;
+        res.name = "synthetic " + std::to_string(_features) + "x" + std::to_string(_trainSamples);
+        std::vector<Eigen::Index> trainClasses;
+        makeSamples(_trainSamples, res.trainInputs, res.trainTargets, trainClasses);
+        matrix_type testTargets;
+        makeSamples(_testSamples, res.testInputs, testTargets, res.testClasses);
+        res.nodes = { _features, 128, 128, _classes };
+        res.epochs = 10;
+        res.batchSize = 64;
+        res.learningRate = 0.5;
+        res.seed = _seed;
+        return res;
+    }
+
+    // trains every dataset once in float and once in double and prints time and accuracy of both
+    void comparePrecision(const std::vector<Dataset>& _datasets) {
+        std::cout << std::left << std::setw(28) << "Dataset"
+            << std::setw(12) << "float ms" << std::setw(12) << "double ms" << std::setw(10) << "speedup"
+            << std::setw(14) << "float acc" << std::setw(14) << "double acc" << std::endl;
+        for (const auto& dataset : _datasets) {
+            Result resFloat = trainWithPrecision<float>(dataset);
+            Result resDouble = trainWithPrecision<double>(dataset);
+            const decimal speedup = static_cast<decimal>(resDouble.milliseconds) / static_cast<decimal>(std::max(resFloat.milliseconds, 1LL));
+            std::cout << std::left << std::setw(28) << dataset.name
+                << std::setw(12) << resFloat.milliseconds << std::setw(12) << resDouble.milliseconds << std::setw(10) << speedup
+                << std::setw(14) << resFloat.accuracy << std::setw(14) << resDouble.accuracy << std::endl;
+        }
+    }
+
+    // trains the same network with trainBatchParallel on 1, 2, 4, ... up to _maxThreads threads and prints
+    // the time per run and the speedup against one thread; Eigen's own threading is switched off meanwhile,
+    // so only the data parallelism over the batch is measured
+    void compareThreads(const Dataset& _dataset, int _maxThreads) {
+        const int eigenThreads = Eigen::nbThreads();
+        Eigen::setNbThreads(1);
+
+        std::vector<int> threadCounts;
+        for (int threads = 1; threads < _maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(std::max(_maxThreads, 1));
+
+        std::cout << std::left << std::setw(10) << "Threads" << std::setw(12) << "ms" << std::setw(10) << "speedup" << std::setw(14) << "accuracy" << std::endl;
+        long long singleThreadMilliseconds = 0;
+        for (int threads : threadCounts) {
+            NeuralNetwork<decimal> nn(_dataset.nodes, _dataset.learningRate, _dataset.seed);
+            matrix_type testOutputs;
+            std::vector<Eigen::Index> predictedClasses;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t epoch = 0; epoch < _dataset.epochs; ++epoch) {
+                for (Eigen::Index j = 0; j < _dataset.trainInputs.cols(); j += _dataset.batchSize) {
+                    const Eigen::Index cols = std::min(_dataset.batchSize, _dataset.trainInputs.cols() - j);
+                    nn.trainBatchParallel(_dataset.trainInputs.middleCols(j, cols), _dataset.trainTargets.middleCols(j, cols), threads);
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            nn.queryBatch(_dataset.testInputs, testOutputs, &predictedClasses);
+
+            const long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            if (threads == 1) {
+                singleThreadMilliseconds = milliseconds;
+            }
+            const decimal speedup = static_cast<decimal>(singleThreadMilliseconds) / static_cast<decimal>(std::max(milliseconds, 1LL));
+            std::cout << std::left << std::setw(10) << threads << std::setw(12) << milliseconds << std::setw(10) << speedup
+                << std::setw(14) << Helpers::getAccuracy(_dataset.testClasses, predictedClasses) << std::endl;
+        }
+
+        Eigen::setNbThreads(eigenThreads);
+    }
+
+    // one pass of the sequential per-sample trainBatch loop (on single-column views, nothing is copied) against one pass of trainHogwild on _threads threads,
+    // both over the same shuffled sample order, prints samples/s and the accuracy after _dataset.epochs epochs
+    void compareHogwild(const Dataset& _dataset, int _threads) {
+        const int eigenThreads = Eigen::nbThreads();
+        Eigen::setNbThreads(1);
+
+        std::mt19937_64 gen{ _dataset.seed };
+        std::vector<Eigen::Index> order(_dataset.trainInputs.cols());
+        std::iota(order.begin(), order.end(), 0);
+
+        auto run = [&](const std::string& _name, auto _trainEpoch) {
+            NeuralNetwork<decimal> nn(_dataset.nodes, _dataset.learningRate, _dataset.seed);
+            matrix_type testOutputs;
+            std::vector<Eigen::Index> predictedClasses;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t epoch = 0; epoch < _dataset.epochs; ++epoch) {
+                std::shuffle(order.begin(), order.end(), gen);
+                _trainEpoch(nn);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            nn.queryBatch(_dataset.testInputs, testOutputs, &predictedClasses);
+
+            const decimal seconds = std::chrono::duration<decimal>(end - start).count();
+            const decimal samplesPerSecond = static_cast<decimal>(order.size() * _dataset.epochs) / seconds;
+            std::cout << std::left << std::setw(24) << _name << std::setw(16) << static_cast<long long>(samplesPerSecond)
+                << std::setw(14) << Helpers::getAccuracy(_dataset.testClasses, predictedClasses) << std::endl;
+        };
+
+        std::cout << std::left << std::setw(24) << "Trainer" << std::setw(16) << "samples/s" << std::setw(14) << "accuracy" << std::endl;
+        run("sequential trainBatch", [&](NeuralNetwork<decimal>& _nn) {
+            for (Eigen::Index j : order) {
+                _nn.trainBatch(_dataset.trainInputs.middleCols(j, 1), _dataset.trainTargets.middleCols(j, 1));
+            }
+        });
+        run("hogwild " + std::to_string(_threads) + " threads", [&](NeuralNetwork<decimal>& _nn) {
+            _nn.trainHogwild(_dataset.trainInputs, _dataset.trainTargets, order, _threads);
+        });
+
+        Eigen::setNbThreads(eigenThreads);
+    }
+
+    // writes a csv file of _rows rows in the layout of iris.csv (4 numeric features and a quoted class name)
+    // to the temp directory and reads it with DataTable::readCsvParallel on 1, 2, 4, ... up to _maxThreads threads,
+    // prints the throughput in MB/s, the best of _repetitions runs
+    void compareCsvThreads(size_t _rows, int _maxThreads, int _repetitions = 3) {
+        const std::filesystem::path csvFile = std::filesystem::temp_directory_path() / "benchmark_iris.csv";
+        {
+            std::mt19937 gen{ 42 };
+            std::uniform_real_distribution<decimal> value(0.1, 8.0);
+            const char* classNames[] = { "Setosa", "Versicolor", "Virginica" };
+            std::ofstream out(csvFile);
+            out << "\"sepal.length\",\"sepal.width\",\"petal.length\",\"petal.width\",\"variety\"\n";
+            out << std::fixed << std::setprecision(3);
+            for (size_t j = 0; j < _rows; ++j) {
+                out << value(gen) << ',' << value(gen) << ',' << value(gen) << ',' << value(gen) << ",\"" << classNames[j % 3] << "\"\n";
+            }
+        }
+        const decimal megabytes = static_cast<decimal>(std::filesystem::file_size(csvFile)) / (1024.0 * 1024.0);
+
+        DataTableMetaData metaData;
+        metaData.targetColumn = 4;
+        metaData.firstLineToRead = 1;
+        metaData.activeFeatures = { 0, 1, 2, 3 };
+
+        std::vector<int> threadCounts;
+        for (int threads = 1; threads < _maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(std::max(_maxThreads, 1));
+
+        std::cout << csvFile.string() << ": " << megabytes << " MB" << std::endl;
+        std::cout << std::left << std::setw(10) << "Threads" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::setw(10) << "rows" << std::endl;
+        for (int threads : threadCounts) {
+            decimal seconds = std::numeric_limits<decimal>::max();
+            size_t rows = 0;
+            for (int r = 0; r < _repetitions; ++r) {
+                DataTable::DataTable<decimal> dataTable;
+                dataTable.setMetaData(metaData);
+                auto start = std::chrono::high_resolution_clock::now();
+                dataTable.readCsvParallel(csvFile.string(), threads);
+                auto end = std::chrono::high_resolution_clock::now();
+                seconds = std::min(seconds, std::chrono::duration<decimal>(end - start).count());
+                rows = dataTable.getNumberOfDatasets();
+            }
+            std::cout << std::left << std::setw(10) << threads << std::setw(12) << static_cast<long long>(seconds * 1000.0)
+                << std::setw(12) << megabytes / seconds << std::setw(10) << rows << std::endl;
+        }
+
+        std::filesystem::remove(csvFile);
+    }
+
+    // writes the training part of _dataset to a csv file in the temp directory (the features and a class name C<k>)
+    // and trains once in memory and once streamed from that file with CsvDataSource and a prefetch thread,
+    // prints samples/s and accuracy of both and the memory the stream keeps for the read block and the shuffle buffer
+    void compareStreaming(const Dataset& _dataset, Eigen::Index _shuffleBufferSize, size_t _blockSize) {
+        const std::filesystem::path csvFile = std::filesystem::temp_directory_path() / "benchmark_stream.csv";
+        DataTableMetaData metaData;
+        metaData.firstLineToRead = 0;
+        metaData.targetColumn = static_cast<size_t>(_dataset.trainInputs.rows());
+        metaData.activeFeatures.resize(metaData.targetColumn);
+        std::iota(metaData.activeFeatures.begin(), metaData.activeFeatures.end(), 0);
+        {
+            std::ofstream out(csvFile);
+            out << std::setprecision(std::numeric_limits<decimal>::max_digits10);
+            for (Eigen::Index j = 0; j < _dataset.trainInputs.cols(); ++j) {
+                Eigen::Index c;
+                _dataset.trainTargets.col(j).maxCoeff(&c);
+                for (Eigen::Index i = 0; i < _dataset.trainInputs.rows(); ++i) {
+                    out << _dataset.trainInputs(i, j) << ',';
+                }
+                out << "\"C" << c << "\"\n";
+            }
+        }
+        const Eigen::Index classes = _dataset.trainTargets.rows();
+        metaData.numberOfClasses = static_cast<size_t>(classes);
+        auto encodeClass = [](std::string_view _cell, Eigen::Ref<vector_type> _target) {
+            Eigen::Index c = 0;
+            std::from_chars(_cell.data() + 1, _cell.data() + _cell.size(), c);
+            _target.setConstant(0.01);
+            _target(c) = 0.99;
+        };
+
+        auto run = [&](const std::string& _name, auto _trainEpoch) {
+            NeuralNetwork<decimal> nn(_dataset.nodes, _dataset.learningRate, _dataset.seed);
+            matrix_type testOutputs;
+            std::vector<Eigen::Index> predictedClasses;
+
+            size_t samples = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t epoch = 0; epoch < _dataset.epochs; ++epoch) {
+                samples += _trainEpoch(nn);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            nn.queryBatch(_dataset.testInputs, testOutputs, &predictedClasses);
+
+            const decimal seconds = std::chrono::duration<decimal>(end - start).count();
+            std::cout << std::left << std::setw(24) << _name << std::setw(16) << static_cast<long long>(static_cast<decimal>(samples) / seconds)
+                << std::setw(14) << Helpers::getAccuracy(_dataset.testClasses, predictedClasses) << std::endl;
+        };
+
+        std::cout << std::left << std::setw(24) << "Trainer" << std::setw(16) << "samples/s" << std::setw(14) << "accuracy" << std::endl;
+        run("in memory", [&](NeuralNetwork<decimal>& _nn) {
+            for (Eigen::Index j = 0; j < _dataset.trainInputs.cols(); j += _dataset.batchSize) {
+                const Eigen::Index cols = std::min(_dataset.batchSize, _dataset.trainInputs.cols() - j);
+                _nn.trainBatch(_dataset.trainInputs.middleCols(j, cols), _dataset.trainTargets.middleCols(j, cols));
+            }
+            return static_cast<size_t>(_dataset.trainInputs.cols());
+        });
+        {
+            DataSource::CsvDataSource<decimal> source(csvFile.string(), metaData, _dataset.batchSize, _shuffleBufferSize, _dataset.seed, _blockSize, encodeClass);
+            run("streamed", [&](NeuralNetwork<decimal>& _nn) { return DataSource::trainEpoch(_nn, source); });
+        }
+        const size_t bufferBytes = _blockSize + static_cast<size_t>(_shuffleBufferSize * (_dataset.trainInputs.rows() + classes)) * sizeof(decimal);
+        std::cout << "stream buffers: " << bufferBytes / 1024 << " KB for a file of " << std::filesystem::file_size(csvFile) / 1024 << " KB" << std::endl;
+
+        std::filesystem::remove(csvFile);
+    }
+}
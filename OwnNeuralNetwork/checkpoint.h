@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <utility>
+#include <algorithm>
+
+#include "nn_defs.h"
+#include "layer.h"
+
+// best-model checkpoints of the early stopping loop: the weights of the best epoch are kept in memory
+// and optionally persisted to disk on a background thread.
+// File layout (little endian):
+//   magic, version, scalar size, number of layers, epoch, accuracy
+//   for every layer: rows, columns, the weights column-major, the bias
+namespace Checkpoint {
+    constexpr char magic[8] = { 'O', 'N', 'N', 'M', 'O', 'D', 'E', 'L' };
+    constexpr uint32_t version = 1;
+
+    // the weights and biases of all layers of a network after an epoch
+    template <typename Scalar>
+    struct Snapshot {
+        std::vector<Layer<Scalar>> layers;
+        size_t epoch = 0;
+        decimal accuracy = -1.0;
+    };
+
+    // writes to a temporary file first and renames it, so a crash never leaves a half written checkpoint behind
+    template <typename Scalar>
+    void write(const std::string& _file, const Snapshot<Scalar>& _snapshot) {
+        const std::string tmpFile = _file + ".tmp";
+        {
+            std::ofstream out(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Could not write the file " + tmpFile);
+            }
+            auto writeValue = [&out](auto _value) {
+                out.write(reinterpret_cast<const char*>(&_value), sizeof(_value));
+            };
+            out.write(magic, sizeof(magic));
+            writeValue(version);
+            writeValue(static_cast<uint32_t>(sizeof(Scalar)));
+            writeValue(static_cast<uint64_t>(_snapshot.layers.size()));
+            writeValue(static_cast<uint64_t>(_snapshot.epoch));
+            writeValue(static_cast<double>(_snapshot.accuracy));
+            for (const auto& layer : _snapshot.layers) {
+                writeValue(static_cast<uint64_t>(layer.weights.rows()));
+                writeValue(static_cast<uint64_t>(layer.weights.cols()));
+                out.write(reinterpret_cast<const char*>(layer.weights.data()), static_cast<std::streamsize>(layer.weights.size() * sizeof(Scalar)));
+                out.write(reinterpret_cast<const char*>(layer.bias.data()), static_cast<std::streamsize>(layer.bias.size() * sizeof(Scalar)));
+            }
+            if (!out) {
+                throw std::runtime_error("Could not write the file " + tmpFile);
+            }
+        }
+        std::filesystem::rename(tmpFile, _file);
+    }
+
+    // false if there is no checkpoint or it was written for another scalar type; throws if the file is not a valid checkpoint
+    template <typename Scalar>
+    bool read(const std::string& _file, Snapshot<Scalar>& _snapshot) {
+        std::ifstream in(_file, std::ios::in | std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+        auto readValue = [&in, &_file](auto& _value) {
+            if (!in.read(reinterpret_cast<char*>(&_value), sizeof(_value))) {
+                throw std::runtime_error("Invalid checkpoint " + _file);
+            }
+        };
+        char fileMagic[8];
+        uint32_t fileVersion, scalarSize;
+        uint64_t layers, epoch;
+        double accuracy;
+        readValue(fileMagic);
+        readValue(fileVersion);
+        readValue(scalarSize);
+        if (std::memcmp(fileMagic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Invalid checkpoint " + _file);
+        }
+        if (fileVersion != version || scalarSize != sizeof(Scalar)) {
+            return false;
+        }
+        readValue(layers);
+        readValue(epoch);
+        readValue(accuracy);
+
+        const uint64_t fileSize = static_cast<uint64_t>(std::filesystem::file_size(_file));
+        _snapshot.layers.clear();
+        for (uint64_t k = 0; k < layers; ++k) {
+            uint64_t rows, cols;
+            readValue(rows);
+            readValue(cols);
+            if (rows == 0 || cols == 0 || rows * (cols + 1) * sizeof(Scalar) > fileSize) {
+                throw std::runtime_error("Invalid checkpoint " + _file);
+            }
+            Layer<Scalar>& layer = _snapshot.layers.emplace_back(static_cast<size_t>(cols), static_cast<size_t>(rows));
+            if (!in.read(reinterpret_cast<char*>(layer.weights.data()), static_cast<std::streamsize>(layer.weights.size() * sizeof(Scalar)))
+                || !in.read(reinterpret_cast<char*>(layer.bias.data()), static_cast<std::streamsize>(layer.bias.size() * sizeof(Scalar)))) {
+                throw std::runtime_error("Invalid checkpoint " + _file);
+            }
+        }
+        _snapshot.epoch = static_cast<size_t>(epoch);
+        _snapshot.accuracy = static_cast<decimal>(accuracy);
+        return true;
+    }
+
+    // loads the weights of the checkpoint _file into _nn, _snapshot receives the whole checkpoint; false as for read;
+    // throws if the file is not a valid checkpoint or its layers do not have the shapes of the layers of _nn
+    template <typename Network>
+    bool load(const std::string& _file, Network& _nn, Snapshot<typename Network::scalar_type>& _snapshot) {
+        if (!read(_file, _snapshot)) {
+            return false;
+        }
+        const auto& layers = _nn.getLayers();
+        bool fits = _snapshot.layers.size() == layers.size();
+        for (size_t k = 0; fits && k < layers.size(); ++k) {
+            fits = _snapshot.layers[k].weights.rows() == layers[k].weights.rows() && _snapshot.layers[k].weights.cols() == layers[k].weights.cols();
+        }
+        if (!fits) {
+            throw std::runtime_error("The checkpoint " + _file + " does not fit the network");
+        }
+        _nn.setLayers(_snapshot.layers);
+        return true;
+    }
+
+    // keeps the best weights of a training run in two preallocated snapshots: save copies the layers into the spare one
+    // and swaps the roles by index, so neither the network with its workspaces is copied nor is memory allocated;
+    // with a file, the best snapshot is written by a background thread while training goes on,
+    // save only waits if the writer still holds the spare snapshot. The first error of the writer is rethrown by flush,
+    // training is not interrupted by it
+    template <typename Network>
+    class Manager {
+    public:
+        using Scalar = typename Network::scalar_type;
+
+        explicit Manager(const Network& _nn, const std::string& _file = "") :
+            file(_file)
+        {
+            for (auto& snapshot : snapshots) {
+                snapshot.layers = _nn.getLayers();
+            }
+            if (!file.empty()) {
+                worker = std::thread([this]() { persist(); });
+            }
+        }
+
+        ~Manager() {
+            if (worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                changed.notify_all();
+                worker.join();
+            }
+        }
+
+        Manager(const Manager&) = delete;
+        Manager& operator=(const Manager&) = delete;
+
+        // takes the weights of _nn as the new best model
+        void save(const Network& _nn, size_t _epoch, decimal _accuracy) {
+            const int spare = best < 0 ? 0 : 1 - best;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this, spare]() { return writing != spare; });
+            }
+            // the layers have the same shapes, so the assignment copies in place
+            snapshots[spare].layers = _nn.getLayers();
+            snapshots[spare].epoch = _epoch;
+            snapshots[spare].accuracy = _accuracy;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                best = spare;
+                pending = true;
+            }
+            changed.notify_all();
+        }
+
+        // copies the best weights back into _nn; false if nothing was saved
+        bool restore(Network& _nn) const {
+            if (best < 0) {
+                return false;
+            }
+            _nn.setLayers(snapshots[best].layers);
+            return true;
+        }
+
+        // waits until the best snapshot is on disk
+        void flush() {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return !worker.joinable() || (!pending && writing < 0); });
+            if (error) {
+                std::rethrow_exception(std::exchange(error, nullptr));
+            }
+        }
+
+        bool hasSnapshot() const {
+            return best >= 0;
+        }
+
+        const Snapshot<Scalar>& getBest() const {
+            return snapshots[std::max(best, 0)];
+        }
+
+    private:
+        void persist() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                changed.wait(lock, [this]() { return pending || stop; });
+                if (!pending) {
+                    return;
+                }
+                writing = best;
+                pending = false;
+                lock.unlock();
+                try {
+                    write(file, snapshots[writing]);
+                }
+                catch (...) {
+                    lock.lock();
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    lock.unlock();
+                }
+                lock.lock();
+                writing = -1;
+                changed.notify_all();
+            }
+        }
+
+        std::string file;
+        std::array<Snapshot<Scalar>, 2> snapshots;
+        // indices into snapshots, -1 for none
+        int best = -1;
+        int writing = -1;
+        bool pending = false;
+        bool stop = false;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::exception_ptr error;
+        std::thread worker;
+    };
+}
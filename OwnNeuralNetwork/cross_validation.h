@@ -0,0 +1,263 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <cassert>
+
+#include "nn_defs.h"
+#include "helpers.h"
+#include "neural_network.h"
+#include "data_table.h"
+#include "splitter.h"
+#include "checkpoint.h"
+#include "optimizers.h"
+#include "schedules.h"
+#include "epoch_order.h"
+
+namespace CrossValidation {
+    // network and training settings of every fold
+    struct Settings {
+        std::vector<size_t> nodes;
+        decimal learningRate = 0.12;
+        size_t epochs = 250;
+        Eigen::Index batchSize = 1;
+        size_t patience = 10;
+        Optimizers::Settings optimizer;
+        Schedules::Settings schedule;
+        Initializers::Type initialization = Initializers::Type::LeCun;
+        // the training samples are visited in a new order every epoch, in blocks of shuffleBlockSize samples if not 0
+        bool shuffle = true;
+        size_t shuffleBlockSize = 0;
+    };
+
+    struct FoldResult {
+        decimal accuracy = -1.0;
+        size_t epochs = 0;
+        long long milliseconds = 0;
+    };
+
+    struct Result {
+        std::vector<FoldResult> folds;
+        decimal meanAccuracy = -1.0;
+        decimal stddevAccuracy = 0.0;
+        long long milliseconds = 0;
+    };
+
+    // robust scaling (x - center) / scale of every feature row, fitted on the training columns of a fold only and applied
+    // to both sides of the fold while the columns are gathered, so the shared data stays unscaled and uncopied;
+    // empty scales nothing
+    template <typename Scalar>
+    struct Scaling {
+        vector_t<Scalar> center;
+        vector_t<Scalar> scale;
+
+        // writes the scaled column _source into _target
+        template <typename Source, typename Target>
+        void apply(const Source& _source, Target&& _target) const {
+            if (center.size() == 0) {
+                _target = _source;
+            }
+            else {
+                _target.array() = (_source.array() - center.array()) / scale.array();
+            }
+        }
+    };
+
+    // median and interquartile range of every row of _inputs over the columns _idcs, as main scales its tables
+    template <typename Scalar>
+    Scaling<Scalar> getScaling(const Eigen::Ref<const matrix_t<Scalar>>& _inputs, std::span<const size_t> _idcs) {
+        Scaling<Scalar> res;
+        res.center.resize(_inputs.rows());
+        res.scale.resize(_inputs.rows());
+        std::vector<Scalar> values(_idcs.size());
+        for (Eigen::Index k = 0; k < _inputs.rows(); ++k) {
+            for (size_t j = 0; j < _idcs.size(); ++j) {
+                values[j] = _inputs(k, _idcs[j]);
+            }
+            res.center(k) = Helpers::getMedian(values);
+            const Scalar iqr = Helpers::getInterquartileRange(values);
+            // a constant feature is only centered
+            res.scale(k) = iqr > Scalar(0) ? iqr : Scalar(1);
+        }
+        return res;
+    }
+
+    // share of the columns _idcs of _inputs that _nn assigns to the class in _labels,
+    // the columns are gathered in chunks into _batchInputs and scaled with _scaling
+    template <typename Network, typename Scalar>
+    decimal getAccuracy(Network& _nn, const Eigen::Ref<const matrix_t<Scalar>>& _inputs, const std::vector<uint32_t>& _labels,
+        std::span<const size_t> _idcs, matrix_t<Scalar>& _batchInputs, matrix_t<Scalar>& _outputs, std::vector<Eigen::Index>& _classes,
+        const Scaling<Scalar>& _scaling = {}) {
+        const Eigen::Index chunk = 256;
+        _batchInputs.resize(_inputs.rows(), chunk);
+        size_t correct = 0;
+        for (size_t begin = 0; begin < _idcs.size(); begin += chunk) {
+            const Eigen::Index cols = static_cast<Eigen::Index>(std::min<size_t>(chunk, _idcs.size() - begin));
+            for (Eigen::Index j = 0; j < cols; ++j) {
+                _scaling.apply(_inputs.col(_idcs[begin + j]), _batchInputs.col(j));
+            }
+            _nn.queryBatch(_batchInputs.leftCols(cols), _outputs, &_classes);
+            for (Eigen::Index j = 0; j < cols; ++j) {
+                correct += _classes[j] == static_cast<Eigen::Index>(_labels[_idcs[begin + j]]);
+            }
+        }
+        return _idcs.empty() ? -1.0 : static_cast<decimal>(correct) / static_cast<decimal>(_idcs.size());
+    }
+
+    // the early stopping loop of main on index views: trains _nn on the columns _trainIdcs of the shared data
+    // and scores it on the columns _testIdcs after every epoch, stops after _settings.patience epochs without
+    // improvement and leaves the best network in _nn; the mini-batches are gathered into buffers of one batch,
+    // the best weights are kept by a Checkpoint::Manager, which also writes them to _checkpointFile if given;
+    // the learning rate follows _settings.schedule from the rate of _nn, which is set again at the end; a warm restart resets the patience
+    // and the optimizer state;
+    // the order of the training samples is shuffled with _seed; the inputs of both sides are scaled with _scaling
+    template <typename Network, typename Scalar>
+    FoldResult trainWithEarlyStopping(Network& _nn, const Eigen::Ref<const matrix_t<Scalar>>& _inputs, const Eigen::Ref<const matrix_t<Scalar>>& _targets,
+        const std::vector<uint32_t>& _labels, std::span<const size_t> _trainIdcs, std::span<const size_t> _testIdcs, const Settings& _settings,
+        uint64_t _seed = 0, const std::string& _checkpointFile = "", const Scaling<Scalar>& _scaling = {}) {
+        const Eigen::Index batchSize = std::max<Eigen::Index>(_settings.batchSize, 1);
+        matrix_t<Scalar> batchInputs(_inputs.rows(), batchSize);
+        // a network with a fused loss is trained on the labels, the target matrix is not read
+        constexpr bool onLabels = Activations::hasFusedLoss<typename Network::output_activation>;
+        matrix_t<Scalar> batchTargets(_targets.rows(), onLabels ? 0 : batchSize);
+        std::vector<uint32_t> batchLabels(onLabels ? batchSize : 0);
+        matrix_t<Scalar> outputs;
+        std::vector<Eigen::Index> classes;
+        Checkpoint::Manager<Network> checkpoint(_nn, _checkpointFile);
+        const Scalar baseRate = _nn.getLearningRate();
+        Schedules::Schedule schedule(_settings.schedule, static_cast<decimal>(baseRate),
+            (_trainIdcs.size() + batchSize - 1) / batchSize, _settings.epochs);
+        // permutes positions in _trainIdcs
+        EpochOrder order(_trainIdcs.size(), _seed, _settings.shuffleBlockSize);
+
+        FoldResult res;
+        size_t patience = _settings.patience;
+        // the workspace of _nn grows in the first epoch only, each fold checks its own network
+        size_t reallocations = 0;
+        for (size_t epoch = 0; epoch < _settings.epochs; ++epoch) {
+            res.epochs = epoch + 1;
+            bool restarted = false;
+            if (_settings.shuffle) {
+                order.shuffle();
+            }
+            const std::span<const uint32_t> positions = order.getOrder();
+            for (size_t begin = 0; begin < _trainIdcs.size(); begin += batchSize) {
+                _nn.setLearningRate(static_cast<Scalar>(schedule.getRate()));
+                const Eigen::Index cols = static_cast<Eigen::Index>(std::min<size_t>(batchSize, _trainIdcs.size() - begin));
+                for (Eigen::Index j = 0; j < cols; ++j) {
+                    const size_t sample = _trainIdcs[positions[begin + j]];
+                    _scaling.apply(_inputs.col(sample), batchInputs.col(j));
+                    if constexpr (onLabels) {
+                        batchLabels[j] = _labels[sample];
+                    }
+                    else {
+                        batchTargets.col(j) = _targets.col(sample);
+                    }
+                }
+                if constexpr (onLabels) {
+                    _nn.trainBatch(batchInputs.leftCols(cols), std::span<const uint32_t>(batchLabels.data(), cols));
+                }
+                else {
+                    _nn.trainBatch(batchInputs.leftCols(cols), batchTargets.leftCols(cols));
+                }
+                if (schedule.onStep()) {
+                    restarted = true;
+                    _nn.resetOptimizer();
+                }
+            }
+
+            const decimal current_accuracy = getAccuracy<Network, Scalar>(_nn, _inputs, _labels, _testIdcs, batchInputs, outputs, classes, _scaling);
+            if (epoch == 0) {
+                reallocations = _nn.getWorkspace().getReallocations();
+            }
+            assert(_nn.getWorkspace().getReallocations() == reallocations);
+            const bool improved = epoch == 0 || current_accuracy >= res.accuracy;
+            if (schedule.onEpoch(improved)) {
+                restarted = true;
+                _nn.resetOptimizer();
+            }
+            if (improved) {
+                patience = _settings.patience;
+                res.accuracy = current_accuracy;
+                checkpoint.save(_nn, epoch, current_accuracy);
+                if (current_accuracy + decimal_eps >= 1.0) {
+                    break;
+                }
+                continue;
+            }
+            if (restarted) {
+                patience = _settings.patience;
+                continue;
+            }
+            // early stopping
+            if (patience == 0 || --patience == 0) {
+                break;
+            }
+        }
+        checkpoint.restore(_nn);
+        checkpoint.flush();
+        _nn.setLearningRate(baseRate);
+        return res;
+    }
+
+    // the network of every fold: sigmoid hidden layers and a softmax output trained on the class labels, like the network of main
+    template <typename Scalar>
+    using FoldNetwork = NeuralNetwork<Scalar, Activations::Sigmoid, Activations::SoftmaxCrossEntropy>;
+
+    // stratified _folds-fold cross-validation on _table: one network per fold, the folds are trained concurrently
+    // on _threads threads and all of them read the shared table through index views, nothing of it is copied;
+    // every fold scales the features with the median and IQR of its own training columns, so the held-out fold
+    // does not leak into the scaling;
+    // _seed decides the folds and the initial weights, so a run is reproducible independent of the threads
+    template <typename Scalar>
+    Result run(const DataTable::DataTable<Scalar>& _table, size_t _folds, const Settings& _settings, uint64_t _seed, int _threads) {
+        Splitter splitter;
+        splitter.pickIdcsForCrossValidation(_table.getLabels(), _folds, _seed);
+        std::vector<std::vector<size_t>> trainIdcs(splitter.getFolds());
+        for (size_t k = 0; k < trainIdcs.size(); ++k) {
+            trainIdcs[k] = splitter.getTrainIdcsOfFold(k);
+        }
+        const auto inputs = _table.getNumericData();
+        const matrix_t<Scalar>& targets = _table.getTargetMatrix();
+
+        Result res;
+        res.folds.resize(splitter.getFolds());
+        auto start = std::chrono::high_resolution_clock::now();
+#pragma omp parallel for num_threads(std::max(_threads, 1)) schedule(dynamic, 1)
+        for (int k = 0; k < static_cast<int>(res.folds.size()); ++k) {
+            auto foldStart = std::chrono::high_resolution_clock::now();
+            FoldNetwork<Scalar> nn(_settings.nodes, static_cast<Scalar>(_settings.learningRate), Helpers::deriveSeed(_seed, k + 1), _settings.initialization);
+            nn.setOptimizer(_settings.optimizer);
+            const Scaling<Scalar> scaling = getScaling<Scalar>(inputs, trainIdcs[k]);
+            res.folds[k] = trainWithEarlyStopping<FoldNetwork<Scalar>, Scalar>(nn, inputs, targets, _table.getLabels(), trainIdcs[k], splitter.getFoldIdcs(k), _settings,
+                Helpers::deriveSeed(_seed, _folds + k + 1), "", scaling);
+            auto foldEnd = std::chrono::high_resolution_clock::now();
+            res.folds[k].milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(foldEnd - foldStart).count();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        res.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        std::vector<decimal> accuracies;
+        for (const auto& fold : res.folds) {
+            accuracies.push_back(fold.accuracy);
+        }
+        res.meanAccuracy = Helpers::getArithmeticMean(accuracies);
+        res.stddevAccuracy = accuracies.size() > 1 ? Helpers::getStandardDeviation(accuracies) : 0.0;
+        return res;
+    }
+
+    void print(const Result& _result) {
+        std::cout << std::left << std::setw(8) << "Fold" << std::setw(12) << "accuracy" << std::setw(10) << "epochs" << std::setw(10) << "ms" << std::endl;
+        for (size_t k = 0; k < _result.folds.size(); ++k) {
+            std::cout << std::left << std::setw(8) << k << std::setw(12) << _result.folds[k].accuracy
+                << std::setw(10) << _result.folds[k].epochs << std::setw(10) << _result.folds[k].milliseconds << std::endl;
+        }
+        std::cout << "mean accuracy " << _result.meanAccuracy << " +- " << _result.stddevAccuracy
+            << ", wall-clock " << _result.milliseconds << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <charconv>
+#include <algorithm>
+
+namespace Csv {
+    // a row of the file that cannot be read, _line is the 1-based line where the row starts
+    class ParseError : public std::runtime_error {
+    public:
+        ParseError(size_t _line, const std::string& _message) :
+            std::runtime_error("CSV line " + std::to_string(_line) + ": " + _message),
+            line(_line)
+        {
+        }
+
+        size_t getLine() const {
+            return line;
+        }
+
+    private:
+        size_t line;
+    };
+
+    // splits the content of a csv file into rows of cells without copying it;
+    // the cells are views into the content, the quotes of a quoted cell are stripped,
+    // a doubled quote inside a quoted cell stays doubled, a quoted cell may contain delimiters and newlines
+    class Tokenizer {
+    public:
+        Tokenizer(std::string_view _content, char _delimiter = ',', size_t _firstLine = 1) :
+            content(_content),
+            delimiter(_delimiter),
+            line(_firstLine)
+        {
+        }
+
+        // reads the next row into _cells, whose capacity is reused; false at the end of the content
+        bool nextRow(std::vector<std::string_view>& _cells) {
+            _cells.clear();
+            if (pos >= content.size()) {
+                return false;
+            }
+            rowLine = line;
+            while (true) {
+                if (pos < content.size() && content[pos] == '"') {
+                    const size_t begin = ++pos;
+                    while (true) {
+                        pos = content.find('"', pos);
+                        if (pos == std::string_view::npos) {
+                            throw ParseError(rowLine, "unterminated quoted cell");
+                        }
+                        if (pos + 1 < content.size() && content[pos + 1] == '"') {
+                            pos += 2;
+                            continue;
+                        }
+                        break;
+                    }
+                    line += std::count(content.begin() + begin, content.begin() + pos, '\n');
+                    _cells.push_back(content.substr(begin, pos - begin));
+                    ++pos;
+                    if (pos < content.size() && content[pos] != delimiter && content[pos] != '\n' && content[pos] != '\r') {
+                        throw ParseError(rowLine, "unexpected character after quoted cell " + std::to_string(_cells.size()));
+                    }
+                }
+                else {
+                    size_t end = pos;
+                    while (end < content.size() && content[end] != delimiter && content[end] != '\n') {
+                        ++end;
+                    }
+                    std::string_view cell = content.substr(pos, end - pos);
+                    if (!cell.empty() && cell.back() == '\r' && (end == content.size() || content[end] == '\n')) {
+                        cell.remove_suffix(1);
+                    }
+                    _cells.push_back(cell);
+                    pos = end;
+                }
+                if (pos < content.size() && content[pos] == '\r') {
+                    ++pos;
+                }
+                if (pos >= content.size()) {
+                    return true;
+                }
+                if (content[pos] == '\n') {
+                    ++pos;
+                    ++line;
+                    return true;
+                }
+                // delimiter
+                ++pos;
+            }
+        }
+
+        // 1-based line where the row read last starts
+        size_t getLine() const {
+            return rowLine;
+        }
+
+        // 1-based line where the next row starts
+        size_t getNextLine() const {
+            return line;
+        }
+
+        // offset of the next row in the content
+        size_t getPosition() const {
+            return pos;
+        }
+
+    private:
+        std::string_view content;
+        char delimiter;
+        size_t pos = 0;
+        size_t line;
+        size_t rowLine = 0;
+    };
+
+    // a range of whole rows of a csv file, firstLine is the 1-based line it starts at
+    struct Chunk {
+        std::string_view content;
+        size_t firstLine;
+    };
+
+    // splits _content into at most _chunks ranges of about equal size, every range starts at the beginning of a row;
+    // a newline inside a quoted cell does not end a row, so the quote parity of every range is counted up to its nominal end
+    std::vector<Chunk> splitIntoChunks(std::string_view _content, size_t _chunks, size_t _firstLine = 1) {
+        std::vector<Chunk> res;
+        const size_t size = _content.size();
+        size_t begin = 0;
+        size_t line = _firstLine;
+        for (size_t k = 1; k <= _chunks && begin < size; ++k) {
+            size_t end = k == _chunks ? size : std::max(begin, size / _chunks * k);
+            bool inQuotes = std::count(_content.begin() + begin, _content.begin() + end, '"') % 2 == 1;
+            // moves the end behind the next newline outside of quotes
+            while (end < size && (end == begin || _content[end - 1] != '\n' || inQuotes)) {
+                if (_content[end] == '"') {
+                    inQuotes = !inQuotes;
+                }
+                ++end;
+            }
+            res.push_back({ _content.substr(begin, end - begin), line });
+            line += std::count(_content.begin() + begin, _content.begin() + end, '\n');
+            begin = end;
+        }
+        return res;
+    }
+
+    // upper bound of the number of rows, used to allocate the column buffers once
+    size_t countLines(std::string_view _content) {
+        if (_content.empty()) {
+            return 0;
+        }
+        return std::count(_content.begin(), _content.end(), '\n') + (_content.back() != '\n');
+    }
+
+    bool isBlank(const std::vector<std::string_view>& _cells) {
+        return _cells.size() == 1 && _cells.front().find_first_not_of(" \t") == std::string_view::npos;
+    }
+
+    // converts a cell to Scalar with std::from_chars, surrounding blanks and a leading '+' are allowed
+    template <typename Scalar>
+    Scalar parseNumber(std::string_view _cell, size_t _line, size_t _column) {
+        const size_t first = _cell.find_first_not_of(" \t");
+        const size_t last = _cell.find_last_not_of(" \t");
+        std::string_view trimmed = first == std::string_view::npos ? std::string_view() : _cell.substr(first, last - first + 1);
+        if (!trimmed.empty() && trimmed.front() == '+') {
+            trimmed.remove_prefix(1);
+        }
+        Scalar res{};
+        const auto [ptr, ec] = std::from_chars(trimmed.data(), trimmed.data() + trimmed.size(), res);
+        if (trimmed.empty() || ec != std::errc() || ptr != trimmed.data() + trimmed.size()) {
+            throw ParseError(_line, "column " + std::to_string(_column) + " is not numeric: '" + std::string(_cell) + "'");
+        }
+        return res;
+    }
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <random>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+
+#include "nn_defs.h"
+#include "helpers.h"
+#include "metadata.h"
+#include "csv_reader.h"
+
+namespace DataSource {
+    // a dataset that is read batch by batch, so it never has to be in memory as a whole
+    template <typename Scalar = decimal>
+    class DataSource {
+    public:
+        virtual ~DataSource() = default;
+
+        // writes the next mini-batch into _inputs and _targets (one column per sample),
+        // the last batch of a pass may be smaller; false if the pass is over
+        virtual bool nextBatch(matrix_t<Scalar>& _inputs, matrix_t<Scalar>& _targets) = 0;
+
+        // starts the next pass over the data
+        virtual void reset() = 0;
+    };
+
+    // streams the active features and the target column of a csv file from disk;
+    // memory is bounded by the read block, the shuffle buffer and one batch, independent of the file size.
+    // The samples are shuffled approximately: a buffer of _shuffleBufferSize samples is kept,
+    // every emitted sample is drawn from it at random and replaced by the next one from the file,
+    // a buffer size of 1 keeps the file order
+    template <typename Scalar = decimal>
+    class CsvDataSource : public DataSource<Scalar> {
+    public:
+        // writes the encoding of a target cell into a column of the target batch; without an encoder the class names
+        // are numbered in the order they appear in the stream and one-hot encoded with the levels 0.01/0.99.
+        // The delimiter and the number of classes (the target rows) are taken from _metaData like for DataTable,
+        // throws if the metadata gives no number of classes
+        using TargetEncoder = std::function<void(std::string_view, Eigen::Ref<vector_t<Scalar>>)>;
+
+        CsvDataSource(const std::string& _csvFile, const DataTableMetaData& _metaData, Eigen::Index _batchSize,
+            Eigen::Index _shuffleBufferSize = 1, uint64_t _seed = std::random_device{}(), size_t _blockSize = 1 << 20,
+            TargetEncoder _targetEncoder = TargetEncoder()) :
+            file(_csvFile, std::ios::in | std::ios::binary),
+            metaData(_metaData),
+            batchSize(std::max<Eigen::Index>(_batchSize, 1)),
+            blockSize(std::max<size_t>(_blockSize, 1)),
+            targetEncoder(std::move(_targetEncoder)),
+            gen(_seed)
+        {
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open the file " + _csvFile);
+            }
+            if (metaData.getNumberOfClasses() == 0) {
+                throw std::invalid_argument("The metadata of " + _csvFile + " gives no number of classes");
+            }
+            const std::vector<size_t>& features = metaData.activeFeatures;
+            minCells = std::max(metaData.getTargetColumn(), features.empty() ? 0 : *std::max_element(features.begin(), features.end())) + 1;
+            shuffleInputs.resize(features.size(), std::max<Eigen::Index>(_shuffleBufferSize, 1));
+            shuffleTargets.resize(static_cast<Eigen::Index>(metaData.getNumberOfClasses()), shuffleInputs.cols());
+            reset();
+        }
+
+        bool nextBatch(matrix_t<Scalar>& _inputs, matrix_t<Scalar>& _targets) override {
+            _inputs.resize(shuffleInputs.rows(), batchSize);
+            _targets.resize(shuffleTargets.rows(), batchSize);
+            Eigen::Index n = 0;
+            for (; n < batchSize && buffered > 0; ++n) {
+                const Eigen::Index r = buffered == 1 ? 0 : std::uniform_int_distribution<Eigen::Index>(0, buffered - 1)(gen);
+                _inputs.col(n) = shuffleInputs.col(r);
+                _targets.col(n) = shuffleTargets.col(r);
+                if (!readSample(r)) {
+                    // the file is exhausted, the buffer is drained
+                    --buffered;
+                    shuffleInputs.col(r) = shuffleInputs.col(buffered);
+                    shuffleTargets.col(r) = shuffleTargets.col(buffered);
+                }
+            }
+            if (n < batchSize) {
+                _inputs.conservativeResize(Eigen::NoChange, n);
+                _targets.conservativeResize(Eigen::NoChange, n);
+            }
+            return n > 0;
+        }
+
+        void reset() override {
+            file.clear();
+            file.seekg(0);
+            block.assign(blockSize, '\0');
+            pos = 0;
+            filled = 0;
+            line = 1;
+            std::vector<std::string_view> header;
+            for (size_t j = 0; j < metaData.getFirstLineToRead() && nextRow(header); ++j) {
+            }
+            buffered = 0;
+            while (buffered < shuffleInputs.cols() && readSample(buffered)) {
+                ++buffered;
+            }
+        }
+
+    private:
+        // reads the next non-blank row of the file into column _col of the shuffle buffer, false at the end of the file
+        bool readSample(Eigen::Index _col) {
+            while (nextRow(cells)) {
+                if (Csv::isBlank(cells)) {
+                    continue;
+                }
+                if (cells.size() < minCells) {
+                    throw Csv::ParseError(rowLine, "expected at least " + std::to_string(minCells) + " cells, found " + std::to_string(cells.size()));
+                }
+                const std::vector<size_t>& features = metaData.activeFeatures;
+                for (size_t k = 0; k < features.size(); ++k) {
+                    shuffleInputs(k, _col) = Csv::parseNumber<Scalar>(cells[features[k]], rowLine, features[k]);
+                }
+                if (targetEncoder) {
+                    targetEncoder(cells[metaData.getTargetColumn()], shuffleTargets.col(_col));
+                }
+                else {
+                    encodeLabel(cells[metaData.getTargetColumn()], _col);
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void encodeLabel(std::string_view _cell, Eigen::Index _col) {
+            const auto [it, inserted] = labels.try_emplace(std::string(_cell), static_cast<Eigen::Index>(labels.size()));
+            if (it->second >= shuffleTargets.rows()) {
+                labels.erase(it);
+                throw Csv::ParseError(rowLine, "more classes than the " + std::to_string(shuffleTargets.rows()) + " target rows");
+            }
+            shuffleTargets.col(_col).setConstant(Scalar(0.01));
+            shuffleTargets(it->second, _col) = Scalar(0.99);
+        }
+
+        // splits the next row of the file into _cells, which point into the block until the next call;
+        // the block is refilled from the file when it holds no complete row and grows for rows longer than it
+        bool nextRow(std::vector<std::string_view>& _cells) {
+            while (true) {
+                bool inQuotes = false;
+                size_t end = pos;
+                for (; end < filled; ++end) {
+                    if (block[end] == '"') {
+                        inQuotes = !inQuotes;
+                    }
+                    else if (block[end] == '\n' && !inQuotes) {
+                        ++end;
+                        break;
+                    }
+                }
+                const bool complete = end <= filled && end > pos && block[end - 1] == '\n' && !inQuotes;
+                if (complete || (file.eof() && end > pos)) {
+                    Csv::Tokenizer tokenizer(std::string_view(block.data() + pos, end - pos), metaData.getDelimiter(), line);
+                    tokenizer.nextRow(_cells);
+                    rowLine = line;
+                    line = tokenizer.getNextLine();
+                    pos = end;
+                    return true;
+                }
+                if (file.eof()) {
+                    return false;
+                }
+                // keeps the incomplete row and reads behind it
+                std::copy(block.begin() + pos, block.begin() + filled, block.begin());
+                filled -= pos;
+                pos = 0;
+                if (filled == block.size()) {
+                    block.resize(2 * block.size());
+                }
+                file.read(block.data() + filled, block.size() - filled);
+                filled += static_cast<size_t>(file.gcount());
+            }
+        }
+
+        std::ifstream file;
+        DataTableMetaData metaData;
+        Eigen::Index batchSize;
+        size_t blockSize;
+        TargetEncoder targetEncoder;
+        // the labels of the default encoder, kept over all passes
+        std::unordered_map<std::string, Eigen::Index> labels;
+        std::mt19937_64 gen;
+        size_t minCells = 0;
+
+        std::vector<char> block;
+        size_t pos = 0;
+        size_t filled = 0;
+        size_t line = 1;
+        size_t rowLine = 0;
+        std::vector<std::string_view> cells;
+
+        matrix_t<Scalar> shuffleInputs;
+        matrix_t<Scalar> shuffleTargets;
+        Eigen::Index buffered = 0;
+    };
+
+    // reads the batches of a source on a background thread, one batch ahead of the consumer (double buffering),
+    // so the I/O and parsing of the next batch overlaps with training on the current one;
+    // an exception of the source is rethrown by nextBatch
+    template <typename Scalar = decimal>
+    class Prefetcher {
+    public:
+        explicit Prefetcher(DataSource<Scalar>& _source) :
+            source(_source),
+            worker([this]() { produce(); })
+        {
+        }
+
+        ~Prefetcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            changed.notify_all();
+            worker.join();
+        }
+
+        Prefetcher(const Prefetcher&) = delete;
+        Prefetcher& operator=(const Prefetcher&) = delete;
+
+        // swaps the prefetched batch into _inputs and _targets, their old storage is reused for a later batch
+        bool nextBatch(matrix_t<Scalar>& _inputs, matrix_t<Scalar>& _targets) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return ready || finished; });
+            if (!ready) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return false;
+            }
+            _inputs.swap(readyInputs);
+            _targets.swap(readyTargets);
+            ready = false;
+            lock.unlock();
+            changed.notify_all();
+            return true;
+        }
+
+    private:
+        void produce() {
+            matrix_t<Scalar> inputs;
+            matrix_t<Scalar> targets;
+            try {
+                while (source.nextBatch(inputs, targets)) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [this]() { return !ready || stop; });
+                    if (stop) {
+                        return;
+                    }
+                    inputs.swap(readyInputs);
+                    targets.swap(readyTargets);
+                    ready = true;
+                    lock.unlock();
+                    changed.notify_all();
+                }
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            changed.notify_all();
+        }
+
+        DataSource<Scalar>& source;
+        std::mutex mutex;
+        std::condition_variable changed;
+        matrix_t<Scalar> readyInputs;
+        matrix_t<Scalar> readyTargets;
+        bool ready = false;
+        bool finished = false;
+        bool stop = false;
+        std::exception_ptr error;
+        // declared last, so the thread starts after all members are initialized
+        std::thread worker;
+    };
+
+    // one pass of _nn.trainBatch over all batches of _source, read ahead by a Prefetcher; returns the number of samples
+    template <typename Network, typename Scalar>
+    size_t trainEpoch(Network& _nn, DataSource<Scalar>& _source) {
+        _source.reset();
+        Prefetcher<Scalar> prefetcher(_source);
+        matrix_t<Scalar> inputs;
+        matrix_t<Scalar> targets;
+        size_t samples = 0;
+        while (prefetcher.nextBatch(inputs, targets)) {
+            _nn.trainBatch(inputs, targets);
+            samples += static_cast<size_t>(inputs.cols());
+        }
+        return samples;
+    }
+}
@@ -7,11 +7,18 @@
 #include <iterator>
 #include <string>
 #include <functional>
+#include <span>
+#include <exception>
+#include <memory>
+#include <unordered_map>
 
 #include "metadata.h"
 #include "splitter.h"
 #include "target_filter.h"
 #include "feature_filter.h"
+#include "mapped_file.h"
+#include "csv_reader.h"
+#include "dataset_cache.h"
 
 #include "nn_defs.h"
 #include "helpers.h"
@@ -25,6 +32,11 @@ T getTrainData(const T& _data, const std::vector<size_t>& _idcs) {
 }
 
 namespace DataTable {
+    // Scalar is the type of the numeric data, float or double;
+    // the numeric data is one contiguous column-major matrix with one row per feature and one column per
+    // dataset (row of the table), so a dataset is contiguous and the matrix is the direct input of
+    // NeuralNetwork::trainBatch/queryBatch
+    template <typename Scalar = decimal>
     class DataTable {
 
     public:
@@ -35,45 +47,101 @@ namespace DataTable {
             metaData = _metaData;
         }
 
-        void setNumericData(const std::vector<std::vector<decimal>>& _numericData) {
-            numericData = _numericData;
+        void setNumericData(const std::vector<std::vector<Scalar>>& _numericData) {
+            dropMapping();
+            numericData = Helpers::convertMatrixElements(_numericData);
         }
 
+        // _numericData has one column per dataset
+        void setNumericData(matrix_t<Scalar>&& _numericData) {
+            dropMapping();
+            numericData = std::move(_numericData);
+        }
+
+        // encodes the target names into labels, see setLabels
         void setTargets(const std::vector<std::string>& _targets) {
-            targets = _targets;
+            std::vector<std::string> names;
+            std::vector<uint32_t> encoded = Helpers::encodeLabels(_targets, names);
+            setLabels(std::move(encoded), std::move(names));
+        }
+
+        // one label per dataset, _labelNames[label] is the name of its class;
+        // the target matrix is encoded once here
+        void setLabels(std::vector<uint32_t> _labels, std::vector<std::string> _labelNames) {
+            labels = std::move(_labels);
+            labelNames = std::move(_labelNames);
+            encodeTargets();
+        }
+
+        // levels of the target matrix, the default 0.01/0.99 suits sigmoid outputs
+        void setTargetLevels(Scalar _low, Scalar _high) {
+            targetLow = _low;
+            targetHigh = _high;
+            encodeTargets();
         }
 
-		std::vector<std::vector<decimal>> getNumericData() const {
-			return numericData;
+        // features x datasets, no data is copied unless the table is mapped from a cache,
+        // then the non-const overload copies it once
+		Eigen::Map<const matrix_t<Scalar>> getNumericData() const {
+			return numeric();
 		}
 
-		std::vector<decimal> getNumericDataColumn(size_t _columnIndex) const {
-            std::vector<decimal> column;
-            for (const auto& row : numericData) {
-                if (_columnIndex < row.size()) {
-                    column.push_back(row[_columnIndex]);
-                }
-                else {
-                    throw std::out_of_range("Spaltenindex auerhalb des Bereichs");
-                }
+		Eigen::Map<matrix_t<Scalar>> getNumericData() {
+			matrix_t<Scalar>& data = ownNumericData();
+			return Eigen::Map<matrix_t<Scalar>>(data.data(), data.rows(), data.cols());
+		}
+
+        // views on a single row, no data is copied
+        std::span<const Scalar> getNumericDataRow(size_t _rowIndex) const {
+            return std::span<const Scalar>(numeric().col(_rowIndex).data(), static_cast<size_t>(numeric().rows()));
+        }
+
+        Eigen::Map<const vector_t<Scalar>> getNumericDataRowMap(size_t _rowIndex) const {
+            return Eigen::Map<const vector_t<Scalar>>(numeric().col(_rowIndex).data(), numeric().rows());
+        }
+
+		std::vector<Scalar> getNumericDataColumn(size_t _columnIndex) const {
+            const auto data = numeric();
+            if (_columnIndex >= static_cast<size_t>(data.rows())) {
+                throw std::out_of_range("Spaltenindex auerhalb des Bereichs");
             }
+            std::vector<Scalar> column(data.cols());
+            Eigen::Map<vector_t<Scalar>>(column.data(), data.cols()) = data.row(_columnIndex).transpose();
             return column;
 		}
 
-        void setNumericDataColumn(size_t columnIndex, const std::vector<decimal>& _newColumn) {
-            if (_newColumn.size() > numericData.size()) {
+        void setNumericDataColumn(size_t columnIndex, const std::vector<Scalar>& _newColumn) {
+            matrix_t<Scalar>& data = ownNumericData();
+            if (_newColumn.size() > static_cast<size_t>(data.cols())) {
                 throw std::out_of_range("Die neue Spalte ist grer als die aktuelle Anzahl an Zeilen");
             }
 
             // Setze die Werte der neuen Spalte
-            for (size_t i = 0; i < _newColumn.size(); ++i) {
-                numericData[i][columnIndex] = _newColumn[i];
-            }
+            data.row(columnIndex).head(_newColumn.size()) = Eigen::Map<const vector_t<Scalar>>(_newColumn.data(), _newColumn.size()).transpose();
         }
 
-		std::vector<std::string> getTargets() const {
-			return targets;
-		}
+        // (x - _center) / _scale for every value of the column, in place
+        void scaleNumericDataColumn(size_t _columnIndex, Scalar _center, Scalar _scale) {
+            matrix_t<Scalar>& data = ownNumericData();
+            data.row(_columnIndex).array() = (data.row(_columnIndex).array() - _center) / _scale;
+        }
+
+        const std::vector<uint32_t>& getLabels() const {
+            return labels;
+        }
+
+        uint32_t getLabel(size_t _rowIndex) const {
+            return labels[_rowIndex];
+        }
+
+        const std::string& getTarget(size_t _rowIndex) const {
+            return labelNames[labels[_rowIndex]];
+        }
+
+        // classes x datasets, the encoded labels
+        const matrix_t<Scalar>& getTargetMatrix() const {
+            return targetMatrix;
+        }
 
         void setData(const std::vector<std::vector<std::string>>& _rawData) {
             FeatureFilter<std::string> featureFilter;
@@ -81,51 +149,233 @@ namespace DataTable {
             std::advance(it, metaData.getFirstLineToRead());
             RawData rawData;
             rawData.setFilteredData(featureFilter.applyFilter(it, _rawData.cend()));
+            dropMapping();
             numericData = rawData.transformData();
-            targets = TargetFilter::applyFilter(it, _rawData.cend(), metaData.getTargetColumn());
+            setTargets(TargetFilter::applyFilter(it, _rawData.cend(), metaData.getTargetColumn()));
         }
 
-        void testTrainSplit(size_t _idcs) {
-            splitter.reset(numericData.size());
-            splitter.pickIdcsRandomly(_idcs, getTargetNames().size());
-            splitter.removeIdcs();
+        // reads the active features and the target column of a csv file straight from the mapped file
+        // into the numeric matrix, no intermediate strings are built; throws Csv::ParseError on a row
+        // that is too short or has a non-numeric feature
+        void readCsv(const std::string& _csvFile) {
+            readCsvParallel(_csvFile, 1);
         }
 
-        std::vector<std::string> getTargetNames() {
-            std::vector<std::string> res = {};
-            std::for_each(targets.begin(), targets.end(), [&res](std::string _x) {if (!std::count(res.begin(), res.end(), _x)) res.push_back(_x); });
-            return res;
+        // as readCsv, but the rows are split into _threads chunks aligned on row boundaries, every chunk is
+        // parsed on its own thread into its own buffers, which are then concatenated in file order
+        void readCsvParallel(const std::string& _csvFile, int _threads) {
+            MappedFile file(_csvFile);
+            const std::string_view content = file.getContent();
+
+            Csv::Tokenizer header(content, metaData.getDelimiter());
+            std::vector<std::string_view> cells;
+            for (size_t j = 0; j < metaData.getFirstLineToRead() && header.nextRow(cells); ++j) {
+            }
+            const std::vector<Csv::Chunk> chunks = Csv::splitIntoChunks(content.substr(header.getPosition()), std::max(_threads, 1), header.getNextLine());
+
+            std::vector<matrix_t<Scalar>> chunkData(chunks.size());
+            std::vector<std::vector<uint32_t>> chunkLabels(chunks.size());
+            std::vector<std::vector<std::string>> chunkLabelNames(chunks.size());
+            std::vector<std::exception_ptr> errors(chunks.size());
+#pragma omp parallel for num_threads(std::max(_threads, 1)) schedule(static, 1)
+            for (int c = 0; c < static_cast<int>(chunks.size()); ++c) {
+                try {
+                    parseChunk(chunks[c], metaData.getDelimiter(), chunkData[c], chunkLabels[c], chunkLabelNames[c]);
+                }
+                catch (...) {
+                    errors[c] = std::current_exception();
+                }
+            }
+            // the first error in file order is reported
+            for (const auto& error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            dropMapping();
+            if (chunks.size() == 1) {
+                numericData = std::move(chunkData.front());
+                setLabels(std::move(chunkLabels.front()), std::move(chunkLabelNames.front()));
+                return;
+            }
+            Eigen::Index rows = 0;
+            for (const auto& data : chunkData) {
+                rows += data.cols();
+            }
+            numericData.resize(metaData.activeFeatures.size(), rows);
+            std::vector<uint32_t> allLabels;
+            allLabels.reserve(rows);
+            // the labels of every chunk are renumbered into one dictionary, merging the chunks in file order
+            // keeps the numbering by first occurrence
+            std::vector<std::string> allLabelNames;
+            std::unordered_map<std::string, uint32_t> codes;
+            Eigen::Index col = 0;
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                numericData.middleCols(col, chunkData[c].cols()) = chunkData[c];
+                col += chunkData[c].cols();
+                chunkData[c].resize(0, 0);
+                std::vector<uint32_t> remap(chunkLabelNames[c].size());
+                for (size_t k = 0; k < remap.size(); ++k) {
+                    const auto [it, inserted] = codes.try_emplace(chunkLabelNames[c][k], static_cast<uint32_t>(allLabelNames.size()));
+                    if (inserted) {
+                        allLabelNames.push_back(chunkLabelNames[c][k]);
+                    }
+                    remap[k] = it->second;
+                }
+                for (uint32_t label : chunkLabels[c]) {
+                    allLabels.push_back(remap[label]);
+                }
+            }
+            setLabels(std::move(allLabels), std::move(allLabelNames));
+        }
+
+        // writes the numeric data and the targets to a binary cache file (see DatasetCache),
+        // _sourceFile is the csv file they were read from, a later readCache fails once it changed
+        void writeCache(const std::string& _cacheFile, const std::string& _sourceFile = "") const {
+            DatasetCache::write<Scalar>(_cacheFile, numeric(), labels, labelNames, metaData, _sourceFile);
+        }
+
+        // maps the numeric data of a cache written by writeCache instead of reading the csv file, nothing is copied
+        // until the data is modified; false if there is no cache for the current metadata and state of _sourceFile
+        bool readCache(const std::string& _cacheFile, const std::string& _sourceFile = "") {
+            DatasetCache::MappedCache<Scalar> cache;
+            if (!DatasetCache::read<Scalar>(_cacheFile, metaData, _sourceFile, cache)) {
+                return false;
+            }
+            numericData.resize(0, 0);
+            mappedFile = std::move(cache.file);
+            mappedData = cache.numericData;
+            mappedRows = cache.features;
+            mappedCols = cache.datasets;
+            setLabels(std::vector<uint32_t>(cache.targetCodes, cache.targetCodes + mappedCols),
+                std::vector<std::string>(cache.targetNames.begin(), cache.targetNames.end()));
+            return true;
+        }
+
+        bool isMapped() const {
+            return mappedData != nullptr;
+        }
+
+        // stratified split with _idcs test datasets, see Splitter::pickIdcsStratified
+        void testTrainSplit(size_t _idcs, uint64_t _seed = 0) {
+            splitter.pickIdcsStratified(labels, _idcs, _seed);
+        }
+
+        // the class names, indexed by label
+        const std::vector<std::string>& getTargetNames() const {
+            return labelNames;
+        }
+
+        size_t getNumberOfClasses() const {
+            return labelNames.size();
         }
 
         size_t getNumberOfDatasets() const {
-			return numericData.size();
+			return static_cast<size_t>(numeric().cols());
         }
 
-        DataTable getTrainDataTable(Splitter splitter) {
+        DataTable getTrainDataTable(const Splitter& splitter) const {
             DataTable res;
 			res.setMetaData(metaData);
-			res.setNumericData(getTrainData<std::vector <std::vector<decimal>>>(numericData, splitter.getIdcs().first));
-            res.setTargets(getTrainData<std::vector<std::string>>(targets, splitter.getIdcs().first));
+			res.setNumericData(numeric()(Eigen::all, splitter.getIdcs().first));
+            res.setTargetLevels(targetLow, targetHigh);
+            res.setLabels(getTrainData<std::vector<uint32_t>>(labels, splitter.getIdcs().first), labelNames);
             return res;
         };
 
-        DataTable getTestDataTable(Splitter splitter) {
+        DataTable getTestDataTable(const Splitter& splitter) const {
             DataTable res;
             res.setMetaData(metaData);
-            res.setNumericData(getTrainData<std::vector <std::vector<decimal>>>(numericData, splitter.getIdcs().second));
-            res.setTargets(getTrainData<std::vector<std::string>>(targets, splitter.getIdcs().second));
+            res.setNumericData(numeric()(Eigen::all, splitter.getIdcs().second));
+            res.setTargetLevels(targetLow, targetHigh);
+            res.setLabels(getTrainData<std::vector<uint32_t>>(labels, splitter.getIdcs().second), labelNames);
             return res;
         };
 
-		std::vector<size_t> getActiveFeatures() const {
+		const std::vector<size_t>& getActiveFeatures() const {
 			return metaData.activeFeatures;
 		}
 
     private:
+        // the numeric data, from the mapped cache if there is one
+        Eigen::Map<const matrix_t<Scalar>> numeric() const {
+            if (mappedData != nullptr) {
+                return Eigen::Map<const matrix_t<Scalar>>(mappedData, mappedRows, mappedCols);
+            }
+            return Eigen::Map<const matrix_t<Scalar>>(numericData.data(), numericData.rows(), numericData.cols());
+        }
+
+        // the numeric data as an owned matrix, a mapped cache is copied before it can be modified
+        matrix_t<Scalar>& ownNumericData() {
+            if (mappedData != nullptr) {
+                numericData = numeric();
+                dropMapping();
+            }
+            return numericData;
+        }
+
+        void encodeTargets() {
+            targetMatrix = Helpers::getOneHotEncodings<Scalar>(labels, labelNames.size(), targetLow, targetHigh);
+        }
+
+        void dropMapping() {
+            mappedFile.reset();
+            mappedData = nullptr;
+            mappedRows = 0;
+            mappedCols = 0;
+        }
+
+        // converts the rows of _chunk into _numericData, one column per row, and the target column into _labels,
+        // numbered in the order of first occurrence of the names, which are collected in _labelNames
+        void parseChunk(const Csv::Chunk& _chunk, char _delimiter, matrix_t<Scalar>& _numericData, std::vector<uint32_t>& _labels, std::vector<std::string>& _labelNames) const {
+            const std::vector<size_t>& features = metaData.activeFeatures;
+            const size_t targetColumn = metaData.getTargetColumn();
+            const size_t minCells = std::max(targetColumn, features.empty() ? 0 : *std::max_element(features.begin(), features.end())) + 1;
+
+            _numericData.resize(features.size(), Csv::countLines(_chunk.content));
+            _labels.clear();
+            _labels.reserve(_numericData.cols());
+            _labelNames.clear();
+            // the keys point into the mapped file, which outlives the parse
+            std::unordered_map<std::string_view, uint32_t> codes;
+
+            Csv::Tokenizer tokenizer(_chunk.content, _delimiter, _chunk.firstLine);
+            std::vector<std::string_view> cells;
+            Eigen::Index row = 0;
+            while (tokenizer.nextRow(cells)) {
+                if (Csv::isBlank(cells)) {
+                    continue;
+                }
+                if (cells.size() < minCells) {
+                    throw Csv::ParseError(tokenizer.getLine(), "expected at least " + std::to_string(minCells) + " cells, found " + std::to_string(cells.size()));
+                }
+                for (size_t k = 0; k < features.size(); ++k) {
+                    _numericData(k, row) = Csv::parseNumber<Scalar>(cells[features[k]], tokenizer.getLine(), features[k]);
+                }
+                const auto [it, inserted] = codes.try_emplace(cells[targetColumn], static_cast<uint32_t>(_labelNames.size()));
+                if (inserted) {
+                    _labelNames.emplace_back(cells[targetColumn]);
+                }
+                _labels.push_back(it->second);
+                ++row;
+            }
+            _numericData.conservativeResize(Eigen::NoChange, row);
+        }
+
         DataTableMetaData metaData;
         Splitter splitter;
-        std::vector<std::vector<decimal>> numericData;
-        std::vector<std::string> targets;
+        matrix_t<Scalar> numericData;
+        // set instead of numericData by readCache, shared by copies of the table
+        std::shared_ptr<const MappedFile> mappedFile;
+        const Scalar* mappedData = nullptr;
+        Eigen::Index mappedRows = 0;
+        Eigen::Index mappedCols = 0;
+        std::vector<uint32_t> labels;
+        std::vector<std::string> labelNames;
+        matrix_t<Scalar> targetMatrix;
+        Scalar targetLow = Scalar(0.01);
+        Scalar targetHigh = Scalar(0.99);
 
         class RawData {
         public:
@@ -136,14 +386,13 @@ namespace DataTable {
 				filteredData = _filteredData;
 			}
 
-            std::vector<std::vector<decimal>> transformData(std::function<decimal(const std::string&)> _convFunc = Helpers::convertElement) {
-                std::vector<std::vector<decimal>> res;
+            // one column per line of the filtered data
+            matrix_t<Scalar> transformData(std::function<Scalar(const std::string&)> _convFunc = Helpers::convertElement<Scalar>) {
+                matrix_t<Scalar> res(filteredData.empty() ? 0 : filteredData.front().size(), filteredData.size());
                 for (size_t j = 0; j < filteredData.size(); ++j) {
-                    std::vector<decimal> line;
                     for (size_t k = 0; k < filteredData[j].size(); ++k) {
-                        line.push_back(_convFunc(filteredData[j][k]));
+                        res(k, j) = _convFunc(filteredData[j][k]);
                     }
-                    res.push_back(line);
                 }
                 return res;
             }
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <tuple>
+#include <limits>
+
+#include "nn_defs.h"
+#include "metadata.h"
+#include "mapped_file.h"
+
+// binary cache of a parsed dataset, written once after reading the csv file and mapped on later runs.
+// Layout (little endian, every block starts at a multiple of blockAlignment):
+//   Header
+//   numeric block: features x datasets values of the scalar type, column-major as in DataTable
+//   target block: one uint32_t class code per dataset
+//   dictionary: for every class code a uint32_t length followed by the name
+namespace DatasetCache {
+    constexpr char magic[8] = { 'O', 'N', 'N', 'C', 'A', 'C', 'H', 'E' };
+    constexpr uint32_t version = 1;
+    constexpr uint64_t blockAlignment = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalarSize;
+        uint64_t features;
+        uint64_t datasets;
+        uint64_t classes;
+        uint64_t numericOffset;
+        uint64_t targetOffset;
+        uint64_t dictionaryOffset;
+        uint64_t fileSize;
+        // the cache is stale if the metadata or the csv file it was made from changed
+        uint64_t metaDataHash;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    uint64_t alignOffset(uint64_t _offset) {
+        return (_offset + blockAlignment - 1) / blockAlignment * blockAlignment;
+    }
+
+    // FNV-1a over the fields of the metadata that decide what is read from the csv file
+    uint64_t getMetaDataHash(const DataTableMetaData& _metaData) {
+        uint64_t res = 14695981039346656037ull;
+        auto add = [&res](uint64_t _value) {
+            for (int k = 0; k < 8; ++k) {
+                res = (res ^ ((_value >> (8 * k)) & 0xff)) * 1099511628211ull;
+            }
+        };
+        add(_metaData.getTargetColumn());
+        add(_metaData.getFirstLineToRead());
+        add(static_cast<unsigned char>(_metaData.getDelimiter()));
+        add(_metaData.activeFeatures.size());
+        for (size_t feature : _metaData.activeFeatures) {
+            add(feature);
+        }
+        return res;
+    }
+
+    // _res = _a * _b, false if the product does not fit into 64 bits
+    bool multiply(uint64_t _a, uint64_t _b, uint64_t& _res) {
+        if (_a != 0 && _b > std::numeric_limits<uint64_t>::max() / _a) {
+            return false;
+        }
+        _res = _a * _b;
+        return true;
+    }
+
+    // size and modification time of the csv file, zero if it is not given or does not exist
+    std::pair<uint64_t, int64_t> getSourceStamp(const std::string& _sourceFile) {
+        std::error_code ec;
+        if (_sourceFile.empty() || !std::filesystem::exists(_sourceFile, ec)) {
+            return { 0, 0 };
+        }
+        return { static_cast<uint64_t>(std::filesystem::file_size(_sourceFile)),
+            static_cast<int64_t>(std::filesystem::last_write_time(_sourceFile).time_since_epoch().count()) };
+    }
+
+    // a mapped cache file, the blocks point into the mapping and stay valid as long as the file is held
+    template <typename Scalar>
+    struct MappedCache {
+        std::shared_ptr<const MappedFile> file;
+        const Scalar* numericData = nullptr;
+        Eigen::Index features = 0;
+        Eigen::Index datasets = 0;
+        const uint32_t* targetCodes = nullptr;
+        std::vector<std::string_view> targetNames;
+    };
+
+    // writes the cache to a temporary file first and renames it, so a reader never sees a half written cache
+    template <typename Scalar>
+    void write(const std::string& _cacheFile, const Eigen::Ref<const matrix_t<Scalar>>& _numericData,
+        const std::vector<uint32_t>& _targetCodes, const std::vector<std::string>& _targetNames,
+        const DataTableMetaData& _metaData, const std::string& _sourceFile) {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.scalarSize = sizeof(Scalar);
+        header.features = static_cast<uint64_t>(_numericData.rows());
+        header.datasets = static_cast<uint64_t>(_numericData.cols());
+        header.classes = _targetNames.size();
+        header.numericOffset = alignOffset(sizeof(Header));
+        header.targetOffset = alignOffset(header.numericOffset + header.features * header.datasets * sizeof(Scalar));
+        header.dictionaryOffset = alignOffset(header.targetOffset + header.datasets * sizeof(uint32_t));
+        header.fileSize = header.dictionaryOffset;
+        for (const auto& name : _targetNames) {
+            header.fileSize += sizeof(uint32_t) + name.size();
+        }
+        header.metaDataHash = getMetaDataHash(_metaData);
+        std::tie(header.sourceSize, header.sourceTime) = getSourceStamp(_sourceFile);
+
+        const std::string tmpFile = _cacheFile + ".tmp";
+        {
+            std::ofstream out(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Could not write the file " + tmpFile);
+            }
+            auto padTo = [&out](uint64_t _offset) {
+                const char zeros[blockAlignment] = {};
+                out.write(zeros, static_cast<std::streamsize>(_offset - static_cast<uint64_t>(out.tellp())));
+            };
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            padTo(header.numericOffset);
+            // the columns of a Ref are contiguous, its outer stride may not be
+            for (Eigen::Index j = 0; j < _numericData.cols(); ++j) {
+                out.write(reinterpret_cast<const char*>(_numericData.col(j).data()), static_cast<std::streamsize>(header.features * sizeof(Scalar)));
+            }
+            padTo(header.targetOffset);
+            out.write(reinterpret_cast<const char*>(_targetCodes.data()), static_cast<std::streamsize>(_targetCodes.size() * sizeof(uint32_t)));
+            padTo(header.dictionaryOffset);
+            for (const auto& name : _targetNames) {
+                const uint32_t length = static_cast<uint32_t>(name.size());
+                out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                out.write(name.data(), length);
+            }
+            if (!out) {
+                throw std::runtime_error("Could not write the file " + tmpFile);
+            }
+        }
+        std::filesystem::rename(tmpFile, _cacheFile);
+    }
+
+    // maps _cacheFile without copying its blocks; false if there is no cache, it was written for another scalar type,
+    // other metadata or another state of _sourceFile; throws if the file is not a valid cache
+    template <typename Scalar>
+    bool read(const std::string& _cacheFile, const DataTableMetaData& _metaData, const std::string& _sourceFile, MappedCache<Scalar>& _res) {
+        std::error_code ec;
+        if (!std::filesystem::exists(_cacheFile, ec)) {
+            return false;
+        }
+        auto file = std::make_shared<MappedFile>(_cacheFile);
+        const std::string_view content = file->getContent();
+
+        Header header;
+        if (content.size() < sizeof(Header)) {
+            throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+        }
+        std::memcpy(&header, content.data(), sizeof(Header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+        }
+        // another version may have another layout, so the layout fields are only looked at for a current cache
+        if (header.version != version || header.scalarSize != sizeof(Scalar) || header.metaDataHash != getMetaDataHash(_metaData)
+            || std::make_pair(header.sourceSize, header.sourceTime) != getSourceStamp(_sourceFile)) {
+            return false;
+        }
+        // the blocks have to follow the header in order, lie inside the file and be aligned for their type;
+        // the block sizes are multiplied with overflow checks, so a corrupt count cannot wrap around
+        uint64_t numericBytes = 0;
+        uint64_t targetBytes = 0;
+        const bool isValid = header.fileSize == content.size()
+            && header.numericOffset >= sizeof(Header)
+            && header.numericOffset <= header.targetOffset && header.targetOffset <= header.dictionaryOffset && header.dictionaryOffset <= header.fileSize
+            && multiply(header.features, header.datasets, numericBytes) && multiply(numericBytes, sizeof(Scalar), numericBytes)
+            && numericBytes <= header.targetOffset - header.numericOffset
+            && multiply(header.datasets, sizeof(uint32_t), targetBytes)
+            && targetBytes <= header.dictionaryOffset - header.targetOffset
+            && reinterpret_cast<std::uintptr_t>(content.data() + header.numericOffset) % alignof(Scalar) == 0
+            && reinterpret_cast<std::uintptr_t>(content.data() + header.targetOffset) % alignof(uint32_t) == 0;
+        if (!isValid) {
+            throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+        }
+
+        _res.targetNames.clear();
+        uint64_t offset = header.dictionaryOffset;
+        for (uint64_t c = 0; c < header.classes; ++c) {
+            uint32_t length;
+            if (offset + sizeof(length) > header.fileSize) {
+                throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+            }
+            std::memcpy(&length, content.data() + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > header.fileSize) {
+                throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+            }
+            _res.targetNames.push_back(content.substr(offset, length));
+            offset += length;
+        }
+
+        _res.numericData = reinterpret_cast<const Scalar*>(content.data() + header.numericOffset);
+        _res.features = static_cast<Eigen::Index>(header.features);
+        _res.datasets = static_cast<Eigen::Index>(header.datasets);
+        _res.targetCodes = reinterpret_cast<const uint32_t*>(content.data() + header.targetOffset);
+        for (Eigen::Index j = 0; j < _res.datasets; ++j) {
+            if (_res.targetCodes[j] >= header.classes) {
+                throw std::runtime_error("Invalid dataset cache " + _cacheFile);
+            }
+        }
+        _res.file = std::move(file);
+        return true;
+    }
+}
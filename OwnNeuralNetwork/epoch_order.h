@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "nn_defs.h"
+
+// the order in which the training samples are visited, permuted anew every epoch;
+// only this index array moves, the data stays where it is and the samples of a mini-batch
+// are gathered into a contiguous buffer (see gatherColumns).
+// With a block size, the samples are cut into blocks of that many neighbouring columns, the order of
+// the blocks and the order within every block are shuffled, so the samples of a mini-batch come from
+// a few consecutive blocks of the data, which keeps the gathers cache-friendly on large tables
+class EpochOrder {
+public:
+    EpochOrder(size_t _samples, uint64_t _seed, size_t _blockSize = 0) :
+        gen(_seed),
+        blockSize(_blockSize)
+    {
+        if (_samples > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Too many samples for 32-bit sample indices");
+        }
+        order.resize(_samples);
+        std::iota(order.begin(), order.end(), uint32_t(0));
+    }
+
+    // the order of the next epoch
+    void shuffle() {
+        if (blockSize == 0 || blockSize >= order.size()) {
+            std::shuffle(order.begin(), order.end(), gen);
+            return;
+        }
+        const size_t blocks = (order.size() + blockSize - 1) / blockSize;
+        blockOrder.resize(blocks);
+        std::iota(blockOrder.begin(), blockOrder.end(), uint32_t(0));
+        std::shuffle(blockOrder.begin(), blockOrder.end(), gen);
+        auto it = order.begin();
+        for (uint32_t block : blockOrder) {
+            const uint32_t begin = static_cast<uint32_t>(block * blockSize);
+            const uint32_t end = static_cast<uint32_t>(std::min(order.size(), begin + blockSize));
+            std::iota(it, it + (end - begin), begin);
+            std::shuffle(it, it + (end - begin), gen);
+            it += end - begin;
+        }
+    }
+
+    std::span<const uint32_t> getOrder() const {
+        return order;
+    }
+
+    // the sample indices of the mini-batch at _begin with up to _batchSize samples
+    std::span<const uint32_t> getBatch(size_t _begin, size_t _batchSize) const {
+        return getOrder().subspan(_begin, std::min(_batchSize, order.size() - _begin));
+    }
+
+    size_t size() const {
+        return order.size();
+    }
+
+private:
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> blockOrder;
+    std::mt19937_64 gen;
+    size_t blockSize;
+};
+
+// copies the columns _idcs of _source into the first _idcs.size() columns of _batch,
+// which has to have that many columns at least, so a buffer of one batch is reused for every batch
+template <typename Scalar>
+void gatherColumns(const Eigen::Ref<const matrix_t<Scalar>>& _source, std::span<const uint32_t> _idcs, Eigen::Ref<matrix_t<Scalar>> _batch) {
+    for (size_t j = 0; j < _idcs.size(); ++j) {
+        _batch.col(j) = _source.col(_idcs[j]);
+    }
+}
+
+// the same for the entries of _source
+template <typename T>
+void gatherEntries(std::span<const T> _source, std::span<const uint32_t> _idcs, std::span<T> _batch) {
+    for (size_t j = 0; j < _idcs.size(); ++j) {
+        _batch[j] = _source[_idcs[j]];
+    }
+}
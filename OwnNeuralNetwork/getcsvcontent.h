@@ -2,33 +2,29 @@
 
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
+#include "mapped_file.h"
+#include "csv_reader.h"
+
+// the whole file as strings, for small files like the metadata;
+// numeric data is read with DataTable::readCsv, which converts the mapped file directly
 std::vector<std::vector<std::string>> getCsvContent(std::string _csvFile, const char delimiter = ',') {
     std::vector<std::vector<std::string>> csvContent = {};
-    std::vector<std::string> row;
-    std::string line, word;
 
-    std::fstream file(_csvFile, std::ios::in);
-    if (!file.is_open())
-    {
+    MappedFile file;
+    try {
+        file.open(_csvFile);
+    }
+    catch (const std::runtime_error&) {
         std::cout << "Could not open the file\n";
         return csvContent;
     }
-    int i = 0;
-    while (getline(file, line))
-    {
-        row.clear();
 
-        std::stringstream str(line);
-
-        while (getline(str, word, delimiter))
-            row.push_back(word);
-        csvContent.push_back(row);
-        ++i;
+    Csv::Tokenizer tokenizer(file.getContent(), delimiter);
+    std::vector<std::string_view> cells;
+    while (tokenizer.nextRow(cells)) {
+        csvContent.emplace_back(cells.begin(), cells.end());
     }
     return csvContent;
 }
-
@@ -1,34 +1,200 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <string>
+#include <span>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <unordered_map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "nn_defs.h"
 
 namespace Helpers {
+    // scalar version for float and double
     template <typename T>
     T sigmoidFunction(T x) {
-        return T();
+        return T(1) / (T(1) + std::exp(-x));
     }
 
-    // Spezialisierung fr double
     template<>
-    decimal sigmoidFunction(decimal x) {
-        return 1.0 / (1.0 + std::exp(-x));
+    vector_type sigmoidFunction(vector_type v) {
+        return (1.0 + (-v.array()).exp()).inverse().matrix();
     }
 
+    // column-wise variant for mini-batches (columns = samples)
     template<>
-    vector_type sigmoidFunction(vector_type v) {
-        vector_type res = v;
-        for (auto j = 0; j < res.size(); ++j) {
-            res(j) = sigmoidFunction<decimal>(v(j));
+    matrix_type sigmoidFunction(matrix_type m) {
+        return (1.0 + (-m.array()).exp()).inverse().matrix();
+    }
+
+    // calls _kernel with the entries of m as an array expression; if the columns are adjacent in memory (e.g. the leftCols
+    // of a workspace buffer) as one flat array, so Eigen vectorizes across the columns also for layers narrower than a packet
+    template <typename Scalar, typename Kernel>
+    void forEachEntry(Eigen::Ref<matrix_t<Scalar>> m, Kernel _kernel) {
+        if (m.outerStride() == m.rows()) {
+            Eigen::Map<vector_t<Scalar>> flat(m.data(), m.size());
+            _kernel(flat.array());
+        }
+        else {
+            _kernel(m.array());
+        }
+    }
+
+    // Activation kernels, evaluated in place with Eigen's packet math (SSE2/AVX/AVX-512, whatever the compiler targets).
+    // Max error against the scalar std:: reference, measured on [-40, 40] (see getMaxUlpError):
+    // double: sigmoidKernel <= 4 ULP, tanhKernel <= 3 ULP;
+    // float, against the double reference rounded to float: sigmoidKernel <= 4 ULP, tanhKernel <= 4 ULP.
+    // Both only need Eigen's packet exp, whose double version is slow without SSE4.1 rounding instructions;
+    // 50 passes over 1M doubles with GCC -O2 against scalar std:: loops:
+    //   SSE2 only (the x86-64 default, also MSVC x64 without /arch): sigmoid 0.36 s vs 0.26 s, tanh 0.64 s vs 0.98 s
+    //   AVX2 + FMA: sigmoid 0.14 s vs 0.32 s, tanh 0.25 s vs 1.18 s
+    // so in double on plain SSE2 the sigmoid kernel is slower than the scalar exp of glibc; in float both are faster on either
+    template <typename Scalar>
+    void sigmoidKernel(Eigen::Ref<matrix_t<Scalar>> m) {
+        forEachEntry<Scalar>(m, [](auto&& _a) { _a = (Scalar(1) + (-_a).exp()).inverse(); });
+    }
+
+    // tanh from exp only, Eigen has packets for exp in float and double but for expm1 in float only:
+    // tanh(x) = 1 - 2 / (exp(2x) + 1) for |x| >= 0.55, where |tanh(x)| >= 0.5 and the subtraction loses no precision,
+    // below tanh(x) = x * p(x^2) with a polynomial p economized from the Taylor series (error < 2e-17);
+    // beyond |x| = 20 tanh is +-1 in double
+    template <typename Scalar>
+    struct TanhOp {
+        static constexpr double split = 0.55;
+        static constexpr double coefficients[] = { 1.0, -0.33333333333331844, 0.13333333333134842, -0.05396825386503023,
+            0.021869485777364125, -0.008863192385732169, 0.0035917054542258836, -0.0014531562714612985,
+            0.000578979470959569, -0.00021007262768307878, 5.087778988841447e-05 };
+
+        Scalar operator()(Scalar _x) const {
+            const Scalar x = std::min(std::max(_x, Scalar(-20)), Scalar(20));
+            if (std::abs(x) >= Scalar(split)) {
+                return Scalar(1) - Scalar(2) / (std::exp(Scalar(2) * x) + Scalar(1));
+            }
+            const Scalar t = x * x;
+            Scalar p = Scalar(coefficients[std::size(coefficients) - 1]);
+            for (size_t k = std::size(coefficients) - 1; k-- > 0;) {
+                p = p * t + Scalar(coefficients[k]);
+            }
+            return x * p;
+        }
+
+        // both branches for a whole packet, blended by the mask of |x| < split
+        template <typename Packet>
+        Packet packetOp(const Packet& _x) const {
+            using namespace Eigen::internal;
+            const Packet x = pmin(pmax(_x, pset1<Packet>(Scalar(-20))), pset1<Packet>(Scalar(20)));
+            const Packet t = pmul(x, x);
+            Packet p = pset1<Packet>(Scalar(coefficients[std::size(coefficients) - 1]));
+            for (size_t k = std::size(coefficients) - 1; k-- > 0;) {
+                p = pmadd(p, t, pset1<Packet>(Scalar(coefficients[k])));
+            }
+            const Packet one = pset1<Packet>(Scalar(1));
+            const Packet large = psub(one, pdiv(pset1<Packet>(Scalar(2)), padd(pexp(padd(x, x)), one)));
+            return pselect(pcmp_lt(pabs(x), pset1<Packet>(Scalar(split))), pmul(x, p), large);
+        }
+    };
+}
+
+namespace Eigen::internal {
+    template <typename Scalar>
+    struct functor_traits<Helpers::TanhOp<Scalar>> {
+        enum {
+            Cost = 40 * NumTraits<Scalar>::MulCost,
+            PacketAccess = packet_traits<Scalar>::HasExp && packet_traits<Scalar>::HasDiv && packet_traits<Scalar>::HasAbs
+        };
+    };
+}
+
+namespace Helpers {
+    template <typename Scalar>
+    void tanhKernel(Eigen::Ref<matrix_t<Scalar>> m) {
+        forEachEntry<Scalar>(m, [](auto&& _a) { _a = _a.unaryExpr(TanhOp<Scalar>()); });
+    }
+
+    // every column becomes a probability distribution, shifted by its maximum so exp cannot overflow
+    template <typename Scalar>
+    void softmaxKernel(Eigen::Ref<matrix_t<Scalar>> m) {
+        for (Eigen::Index j = 0; j < m.cols(); ++j) {
+            auto column = m.col(j);
+            column.array() = (column.array() - column.maxCoeff()).exp();
+            column /= column.sum();
+        }
+    }
+
+    // summed categorical cross-entropy of the classes _labels under the softmax of the columns of _logits,
+    // evaluated as log-sum-exp minus the logit of the class, so it stays finite where softmax underflows to 0
+    template <typename Scalar>
+    Scalar getCrossEntropy(const Eigen::Ref<const matrix_t<Scalar>>& _logits, std::span<const uint32_t> _labels) {
+        Scalar res = 0;
+        for (Eigen::Index j = 0; j < _logits.cols(); ++j) {
+            const Scalar shift = _logits.col(j).maxCoeff();
+            res += shift + std::log((_logits.col(j).array() - shift).exp().sum()) - _logits(_labels[j], j);
         }
         return res;
     }
 
-	decimal convertElement(const std::string& _in) {
-		return std::stod(_in);
+    // distance of two floating point numbers in units in the last place
+    template <typename Scalar>
+    uint64_t getUlpDistance(Scalar a, Scalar b) {
+        using bits_type = std::conditional_t<sizeof(Scalar) == 8, int64_t, int32_t>;
+        auto ordered = [](Scalar x) {
+            bits_type i;
+            std::memcpy(&i, &x, sizeof(x));
+            // maps the sign-magnitude representation to a monotonic integer scale
+            return i < 0 ? static_cast<int64_t>(std::numeric_limits<bits_type>::min()) - i : static_cast<int64_t>(i);
+        };
+        const int64_t ia = ordered(a);
+        const int64_t ib = ordered(b);
+        return ia > ib ? static_cast<uint64_t>(ia - ib) : static_cast<uint64_t>(ib - ia);
+    }
+
+    // max ULP error of an in-place _kernel against the scalar _reference on _points points in [_from, _to]
+    template <typename Scalar, typename Kernel, typename Reference>
+    uint64_t getMaxUlpError(Kernel _kernel, Reference _reference, Scalar _from = -40, Scalar _to = 40, Eigen::Index _points = 100001) {
+        matrix_t<Scalar> x = vector_t<Scalar>::LinSpaced(_points, _from, _to);
+        matrix_t<Scalar> y = x;
+        _kernel(y);
+        uint64_t res = 0;
+        for (Eigen::Index j = 0; j < x.size(); ++j) {
+            res = std::max(res, getUlpDistance(y(j), _reference(x(j))));
+        }
+        return res;
+    }
+
+    // seed of the random stream _stream of a run with seed _seed, e.g. one stream for the weights and one per fold;
+    // the splitmix64 finalizer decorrelates the streams of neighbouring seeds
+    uint64_t deriveSeed(uint64_t _seed, uint64_t _stream) {
+        uint64_t z = _seed + (_stream + 1) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // number of threads an OpenMP parallel region would use, 1 if built without OpenMP
+    int getMaxThreads() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+	template <typename Scalar = decimal>
+	Scalar convertElement(const std::string& _in) {
+		return static_cast<Scalar>(std::stod(_in));
 	}
 
-    vector_type convertVectorElements(const std::vector<decimal>& _in) {
-        vector_type result(_in.size());
+    template <typename Scalar>
+    vector_t<Scalar> convertVectorElements(const std::vector<Scalar>& _in) {
+        vector_t<Scalar> result(_in.size());
 
         for (std::size_t i = 0; i < _in.size(); ++i) {
             result[i] = _in[i];
@@ -37,6 +203,20 @@ namespace Helpers {
         return result;
     }
 
+    // builds a matrix with one column per row of _in (columns = samples)
+    template <typename Scalar>
+    matrix_t<Scalar> convertMatrixElements(const std::vector<std::vector<Scalar>>& _in) {
+        matrix_t<Scalar> result(_in.empty() ? 0 : _in.front().size(), _in.size());
+
+        for (std::size_t j = 0; j < _in.size(); ++j) {
+            for (std::size_t i = 0; i < _in[j].size(); ++i) {
+                result(i, j) = _in[j][i];
+            }
+        }
+
+        return result;
+    }
+
     vector_type ConvFunc(const std::vector<std::string>& _in) {
         size_t siz = _in.size();
         vector_type res(siz);
@@ -51,9 +231,10 @@ namespace Helpers {
         return res;
     }
 
-    vector_type getEncoding(const std::string& _in) {
-        decimal almostZero = 0.01;
-        vector_type res{ {almostZero, almostZero, almostZero} };
+    template <typename Scalar = decimal>
+    vector_t<Scalar> getEncoding(const std::string& _in) {
+        Scalar almostZero = Scalar(0.01);
+        vector_t<Scalar> res{ {almostZero, almostZero, almostZero} };
         if (_in.find("Setosa") != std::string::npos) {
             res(0) = 1.0 - almostZero;
         }
@@ -66,7 +247,48 @@ namespace Helpers {
         return res;
     }
 
-    size_t getCorrectPredictions(const std::vector<vector_type>& targets, const std::vector<vector_type>& predicted_targets) {
+    // one encoded target column per entry of _in
+    template <typename Scalar = decimal>
+    matrix_t<Scalar> getEncodings(const std::vector<std::string>& _in) {
+        matrix_t<Scalar> res(3, _in.size());
+        for (std::size_t j = 0; j < _in.size(); ++j) {
+            res.col(j) = getEncoding<Scalar>(_in[j]);
+        }
+        return res;
+    }
+
+    // the label of every entry of _in, labels are numbered in the order of the first occurrence of their name,
+    // the names are appended to _labelNames; linear in the number of entries thanks to the hash map
+    std::vector<uint32_t> encodeLabels(const std::vector<std::string>& _in, std::vector<std::string>& _labelNames) {
+        std::unordered_map<std::string, uint32_t> codes;
+        for (size_t c = 0; c < _labelNames.size(); ++c) {
+            codes.emplace(_labelNames[c], static_cast<uint32_t>(c));
+        }
+        std::vector<uint32_t> res;
+        res.reserve(_in.size());
+        for (const auto& name : _in) {
+            const auto [it, inserted] = codes.try_emplace(name, static_cast<uint32_t>(_labelNames.size()));
+            if (inserted) {
+                _labelNames.push_back(name);
+            }
+            res.push_back(it->second);
+        }
+        return res;
+    }
+
+    // one column per label with _high in the row of the label and _low elsewhere;
+    // label smoothing with epsilon over K classes is _low = epsilon / K, _high = 1 - epsilon + epsilon / K
+    template <typename Scalar = decimal>
+    matrix_t<Scalar> getOneHotEncodings(const std::vector<uint32_t>& _labels, size_t _classes, Scalar _low = Scalar(0), Scalar _high = Scalar(1)) {
+        matrix_t<Scalar> res = matrix_t<Scalar>::Constant(_classes, _labels.size(), _low);
+        for (size_t j = 0; j < _labels.size(); ++j) {
+            res(_labels[j], j) = _high;
+        }
+        return res;
+    }
+
+    template <typename Scalar>
+    size_t getCorrectPredictions(const std::vector<vector_t<Scalar>>& targets, const std::vector<vector_t<Scalar>>& predicted_targets) {
         // round to next int
 
         if (targets.size() != predicted_targets.size())
@@ -76,8 +298,8 @@ namespace Helpers {
 
         size_t corr_predictions = 0;
         for (auto it = targets.begin(), it1 = predicted_targets.begin(); it != targets.end(); ++it, ++it1) {
-            Eigen::VectorXd rounded_it = it->unaryExpr([](double v) { return std::round(v); });
-            Eigen::VectorXd rounded_it1 = it1->unaryExpr([](double v) { return std::round(v); });
+            vector_t<Scalar> rounded_it = it->unaryExpr([](Scalar v) { return std::round(v); });
+            vector_t<Scalar> rounded_it1 = it1->unaryExpr([](Scalar v) { return std::round(v); });
 
             auto dotProduct = rounded_it.dot(rounded_it1);
             corr_predictions += dotProduct;
@@ -85,7 +307,8 @@ namespace Helpers {
         return corr_predictions;
     }
 
-    decimal getAccuracy(const std::vector<vector_type>& targets, const std::vector<vector_type>& predicted_targets) {
+    template <typename Scalar>
+    decimal getAccuracy(const std::vector<vector_t<Scalar>>& targets, const std::vector<vector_t<Scalar>>& predicted_targets) {
         if (targets.size() != predicted_targets.size())
         {
             return -1.0;
@@ -94,28 +317,64 @@ namespace Helpers {
         return static_cast<decimal>(getCorrectPredictions(targets, predicted_targets)) / static_cast<decimal>(targets.size());
     }
 
-	decimal getArithmeticMean(std::vector<decimal> _in) {
-		decimal sum = std::accumulate(_in.begin(), _in.end(), 0.0);
+    // index of the largest entry of every column, i.e. the class of every sample
+    template <typename Scalar>
+    std::vector<Eigen::Index> getClassIndices(const matrix_t<Scalar>& _in) {
+        std::vector<Eigen::Index> res(_in.cols());
+        for (Eigen::Index j = 0; j < _in.cols(); ++j) {
+            _in.col(j).maxCoeff(&res[j]);
+        }
+        return res;
+    }
+
+    size_t getCorrectPredictions(const std::vector<Eigen::Index>& classes, const std::vector<Eigen::Index>& predicted_classes) {
+        if (classes.size() != predicted_classes.size())
+        {
+            return SIZE_MAX;
+        }
+
+        size_t corr_predictions = 0;
+        for (size_t j = 0; j < classes.size(); ++j) {
+            corr_predictions += classes[j] == predicted_classes[j];
+        }
+        return corr_predictions;
+    }
+
+    decimal getAccuracy(const std::vector<Eigen::Index>& classes, const std::vector<Eigen::Index>& predicted_classes) {
+        if (classes.size() != predicted_classes.size())
+        {
+            return -1.0;
+        }
+
+        return static_cast<decimal>(getCorrectPredictions(classes, predicted_classes)) / static_cast<decimal>(classes.size());
+    }
+
+	template <typename Scalar>
+	Scalar getArithmeticMean(std::vector<Scalar> _in) {
+		Scalar sum = std::accumulate(_in.begin(), _in.end(), Scalar(0));
 		return sum / _in.size();
 	}
 
-    decimal getStandardDeviation(std::vector<decimal> _in) {
-        decimal mean = getArithmeticMean(_in);
-        decimal sum = std::accumulate(_in.begin(), _in.end(), 0.0, [mean](decimal _x, decimal _y) {return _x + (_y - mean) * (_y - mean); });
-        decimal variance = sum / (_in.size() - 1);
+    template <typename Scalar>
+    Scalar getStandardDeviation(std::vector<Scalar> _in) {
+        Scalar mean = getArithmeticMean(_in);
+        Scalar sum = std::accumulate(_in.begin(), _in.end(), Scalar(0), [mean](Scalar _x, Scalar _y) {return _x + (_y - mean) * (_y - mean); });
+        Scalar variance = sum / (_in.size() - 1);
         return std::sqrt(variance);
     }
 
-	decimal getMedian(std::vector<decimal> _in) {
+	template <typename Scalar>
+	Scalar getMedian(std::vector<Scalar> _in) {
 		std::sort(_in.begin(), _in.end());
 		size_t siz = _in.size();
 		if (siz % 2 == 0) {
-			return (_in[siz / 2 - 1] + _in[siz / 2]) / 2.0;
+			return (_in[siz / 2 - 1] + _in[siz / 2]) / Scalar(2);
 		}
 		return _in[siz / 2];
 	}
 
-	decimal getInterquartileRange(std::vector<decimal> _in) {
+	template <typename Scalar>
+	Scalar getInterquartileRange(std::vector<Scalar> _in) {
 		std::sort(_in.begin(), _in.end());
 		size_t siz = _in.size();
 		size_t q1 = siz / 4;
@@ -123,8 +382,9 @@ namespace Helpers {
 		return _in[q3] - _in[q1];
 	}
 
-	std::vector<decimal> getStandardScaling(std::vector<decimal> _in, decimal _mean, decimal _sd) {
-        std::vector<decimal> res;
+	template <typename Scalar>
+	std::vector<Scalar> getStandardScaling(std::vector<Scalar> _in, Scalar _mean, Scalar _sd) {
+        std::vector<Scalar> res;
         res.reserve(_in.size());
 		for (auto it = _in.cbegin(); it != _in.cend(); ++it) {
 			res.push_back((*it - _mean) / _sd);
@@ -132,8 +392,9 @@ namespace Helpers {
 		return res;
 	}
 
-	std::vector<decimal> getRobustScaling(std::vector<decimal> _in, decimal _median, decimal _iqr) {
-        std::vector<decimal> res;
+	template <typename Scalar>
+	std::vector<Scalar> getRobustScaling(std::vector<Scalar> _in, Scalar _median, Scalar _iqr) {
+        std::vector<Scalar> res;
         res.reserve(_in.size());
 		for (auto it = _in.cbegin(); it != _in.cend(); ++it) {
 			res.push_back((*it - _median) / _iqr);
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+#include "nn_defs.h"
+#include "activations.h"
+#include "neural_network.h"
+#include "data_table.h"
+#include "splitter.h"
+#include "cross_validation.h"
+#include "optimizers.h"
+
+namespace HyperparameterSearch {
+    // activation of the hidden layers, the output layer is a softmax trained on the class labels
+    enum class Activation {
+        Sigmoid,
+        Tanh,
+        ReLU,
+        LeakyReLU
+    };
+
+    std::string getName(Activation _activation) {
+        switch (_activation) {
+        case Activation::Tanh:
+            return "tanh";
+        case Activation::ReLU:
+            return "relu";
+        case Activation::LeakyReLU:
+            return "leaky_relu";
+        default:
+            return "sigmoid";
+        }
+    }
+
+    // one network with a single hidden layer and its training settings
+    struct Trial {
+        size_t hiddenNodes = 4;
+        decimal learningRate = 0.12;
+        Eigen::Index batchSize = 1;
+        Activation activation = Activation::Sigmoid;
+        Optimizers::Type optimizer = Optimizers::Type::SGD;
+        // the position in the list the trial was generated in, seeds its initial weights,
+        // so a trial promoted by successive halving starts from the same weights in every rung
+        size_t id = 0;
+    };
+
+    // the values to search, random search samples the hidden nodes and the learning rate (log-uniform)
+    // between the smallest and largest value given and picks batch size, activation and optimizer from the lists
+    struct SearchSpace {
+        std::vector<size_t> hiddenNodes = { 4, 8, 16 };
+        std::vector<decimal> learningRates = { 0.03, 0.12, 0.5 };
+        std::vector<Eigen::Index> batchSizes = { 1, 8, 32 };
+        std::vector<Activation> activations = { Activation::Sigmoid, Activation::Tanh, Activation::ReLU, Activation::LeakyReLU };
+        std::vector<Optimizers::Type> optimizers = { Optimizers::Type::SGD };
+    };
+
+    struct TrialResult {
+        Trial trial;
+        // the epoch budget of the trial, smaller than the maximum in the early rungs of successive halving
+        size_t epochBudget = 0;
+        CrossValidation::FoldResult result;
+    };
+
+    std::vector<Trial> getGrid(const SearchSpace& _space) {
+        std::vector<Trial> res;
+        for (size_t hiddenNodes : _space.hiddenNodes) {
+            for (decimal learningRate : _space.learningRates) {
+                for (Eigen::Index batchSize : _space.batchSizes) {
+                    for (Activation activation : _space.activations) {
+                        for (Optimizers::Type optimizer : _space.optimizers) {
+                            res.push_back({ hiddenNodes, learningRate, batchSize, activation, optimizer, res.size() });
+                        }
+                    }
+                }
+            }
+        }
+        return res;
+    }
+
+    std::vector<Trial> getRandomTrials(const SearchSpace& _space, size_t _trials, uint64_t _seed) {
+        std::mt19937_64 gen{ _seed };
+        const auto [minNodes, maxNodes] = std::minmax_element(_space.hiddenNodes.begin(), _space.hiddenNodes.end());
+        const auto [minRate, maxRate] = std::minmax_element(_space.learningRates.begin(), _space.learningRates.end());
+        std::uniform_int_distribution<size_t> hiddenNodes(*minNodes, *maxNodes);
+        std::uniform_real_distribution<decimal> logRate(std::log(*minRate), std::log(*maxRate));
+        std::uniform_int_distribution<size_t> batchSize(0, _space.batchSizes.size() - 1);
+        std::uniform_int_distribution<size_t> activation(0, _space.activations.size() - 1);
+        std::uniform_int_distribution<size_t> optimizer(0, _space.optimizers.size() - 1);
+        std::vector<Trial> res(_trials);
+        for (size_t t = 0; t < res.size(); ++t) {
+            Trial& trial = res[t];
+            trial.id = t;
+            trial.hiddenNodes = hiddenNodes(gen);
+            trial.learningRate = std::exp(logRate(gen));
+            trial.batchSize = _space.batchSizes[batchSize(gen)];
+            trial.activation = _space.activations[activation(gen)];
+            trial.optimizer = _space.optimizers[optimizer(gen)];
+        }
+        return res;
+    }
+
+    // trains a fresh network of the trial on the columns _trainIdcs of _table and scores it on _validationIdcs,
+    // the early stopping of CrossValidation::trainWithEarlyStopping ends trials that stop improving
+    template <typename Hidden, typename Scalar>
+    CrossValidation::FoldResult runTrial(const DataTable::DataTable<Scalar>& _table, const std::vector<size_t>& _trainIdcs,
+        const std::vector<size_t>& _validationIdcs, const CrossValidation::Settings& _settings, uint64_t _seed) {
+        using Network = NeuralNetwork<Scalar, Hidden, Activations::SoftmaxCrossEntropy>;
+        Network nn(_settings.nodes, static_cast<Scalar>(_settings.learningRate), _seed, _settings.initialization);
+        nn.setOptimizer(_settings.optimizer);
+        return CrossValidation::trainWithEarlyStopping<Network, Scalar>(nn, _table.getNumericData(), _table.getTargetMatrix(),
+            _table.getLabels(), _trainIdcs, _validationIdcs, _settings, Helpers::deriveSeed(_seed, 1));
+    }
+
+    template <typename Scalar>
+    CrossValidation::FoldResult runTrial(const Trial& _trial, const DataTable::DataTable<Scalar>& _table, const std::vector<size_t>& _trainIdcs,
+        const std::vector<size_t>& _validationIdcs, size_t _epochs, size_t _patience, uint64_t _seed) {
+        CrossValidation::Settings settings;
+        settings.nodes = { _table.getActiveFeatures().size(), _trial.hiddenNodes, _table.getNumberOfClasses() };
+        settings.learningRate = _trial.learningRate;
+        settings.epochs = _epochs;
+        settings.batchSize = _trial.batchSize;
+        settings.patience = _patience;
+        settings.optimizer.type = _trial.optimizer;
+        // He initialization suits the rectifiers, LeCun the saturating activations
+        settings.initialization = _trial.activation == Activation::ReLU || _trial.activation == Activation::LeakyReLU ? Initializers::Type::He : Initializers::Type::LeCun;
+        // the activation is a compile-time policy, so every choice is its own network type
+        switch (_trial.activation) {
+        case Activation::Tanh:
+            return runTrial<Activations::Tanh>(_table, _trainIdcs, _validationIdcs, settings, _seed);
+        case Activation::ReLU:
+            return runTrial<Activations::ReLU>(_table, _trainIdcs, _validationIdcs, settings, _seed);
+        case Activation::LeakyReLU:
+            return runTrial<Activations::LeakyReLU>(_table, _trainIdcs, _validationIdcs, settings, _seed);
+        default:
+            return runTrial<Activations::Sigmoid>(_table, _trainIdcs, _validationIdcs, settings, _seed);
+        }
+    }
+
+    // runs all _trials on _threads threads, every trial with its own network on the shared, unmodified _table;
+    // the initial weights of a trial are seeded from _seed and its id; the results are sorted by accuracy, best first
+    template <typename Scalar>
+    std::vector<TrialResult> run(const std::vector<Trial>& _trials, const DataTable::DataTable<Scalar>& _table, const std::vector<size_t>& _trainIdcs,
+        const std::vector<size_t>& _validationIdcs, size_t _epochs, size_t _patience, uint64_t _seed, int _threads) {
+        std::vector<TrialResult> res(_trials.size());
+#pragma omp parallel for num_threads(std::max(_threads, 1)) schedule(dynamic, 1)
+        for (int t = 0; t < static_cast<int>(_trials.size()); ++t) {
+            auto start = std::chrono::high_resolution_clock::now();
+            res[t].trial = _trials[t];
+            res[t].epochBudget = _epochs;
+            res[t].result = runTrial(_trials[t], _table, _trainIdcs, _validationIdcs, _epochs, _patience, Helpers::deriveSeed(_seed, _trials[t].id));
+            auto end = std::chrono::high_resolution_clock::now();
+            res[t].result.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        }
+        std::stable_sort(res.begin(), res.end(), [](const TrialResult& _a, const TrialResult& _b) { return _a.result.accuracy > _b.result.accuracy; });
+        return res;
+    }
+
+    // successive halving: all trials get _epochs / _eta^(rungs - 1) epochs, the best 1 / _eta of them are trained again
+    // with _eta times the budget, until one rung runs with the full _epochs; returns the results of all rungs, last rung first
+    template <typename Scalar>
+    std::vector<TrialResult> runSuccessiveHalving(std::vector<Trial> _trials, const DataTable::DataTable<Scalar>& _table, const std::vector<size_t>& _trainIdcs,
+        const std::vector<size_t>& _validationIdcs, size_t _epochs, size_t _patience, size_t _eta, uint64_t _seed, int _threads) {
+        _eta = std::max<size_t>(_eta, 2);
+        size_t rungs = 1;
+        for (size_t trials = _trials.size(); trials > _eta; trials /= _eta) {
+            ++rungs;
+        }
+
+        std::vector<TrialResult> res;
+        for (size_t r = 0; r < rungs; ++r) {
+            size_t budget = _epochs;
+            for (size_t k = r + 1; k < rungs; ++k) {
+                budget /= _eta;
+            }
+            std::vector<TrialResult> rung = run(_trials, _table, _trainIdcs, _validationIdcs, std::max<size_t>(budget, 1), _patience, _seed, _threads);
+            res.insert(res.begin(), rung.begin(), rung.end());
+            _trials.clear();
+            for (size_t t = 0; t < std::max<size_t>(rung.size() / _eta, 1); ++t) {
+                _trials.push_back(rung[t].trial);
+            }
+        }
+        return res;
+    }
+
+    void writeCsv(const std::vector<TrialResult>& _results, const std::string& _file) {
+        std::ofstream out(_file);
+        out << "trial,hiddenNodes,learningRate,batchSize,activation,optimizer,epochBudget,epochs,accuracy,milliseconds\n";
+        for (const auto& res : _results) {
+            out << res.trial.id << ',' << res.trial.hiddenNodes << ',' << res.trial.learningRate << ',' << res.trial.batchSize << ',' << getName(res.trial.activation) << ','
+                << Optimizers::getName(res.trial.optimizer) << ','
+                << res.epochBudget << ',' << res.result.epochs << ',' << res.result.accuracy << ',' << res.result.milliseconds << '\n';
+        }
+    }
+
+    void writeJson(const std::vector<TrialResult>& _results, const std::string& _file) {
+        std::ofstream out(_file);
+        out << "[\n";
+        for (size_t t = 0; t < _results.size(); ++t) {
+            const auto& res = _results[t];
+            out << "  {\"trial\": " << res.trial.id << ", \"hiddenNodes\": " << res.trial.hiddenNodes << ", \"learningRate\": " << res.trial.learningRate
+                << ", \"batchSize\": " << res.trial.batchSize << ", \"activation\": \"" << getName(res.trial.activation)
+                << "\", \"optimizer\": \"" << Optimizers::getName(res.trial.optimizer)
+                << "\", \"epochBudget\": " << res.epochBudget << ", \"epochs\": " << res.result.epochs
+                << ", \"accuracy\": " << res.result.accuracy << ", \"milliseconds\": " << res.result.milliseconds << "}"
+                << (t + 1 < _results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    void print(const std::vector<TrialResult>& _results, size_t _count) {
+        std::cout << std::left << std::setw(8) << "hidden" << std::setw(12) << "lr" << std::setw(8) << "batch" << std::setw(12) << "activation"
+            << std::setw(10) << "optimizer" << std::setw(8) << "budget" << std::setw(8) << "epochs" << std::setw(12) << "accuracy" << std::setw(8) << "ms" << std::endl;
+        for (size_t t = 0; t < std::min(_count, _results.size()); ++t) {
+            const auto& res = _results[t];
+            std::cout << std::left << std::setw(8) << res.trial.hiddenNodes << std::setw(12) << res.trial.learningRate << std::setw(8) << res.trial.batchSize
+                << std::setw(12) << getName(res.trial.activation) << std::setw(10) << Optimizers::getName(res.trial.optimizer) << std::setw(8) << res.epochBudget << std::setw(8) << res.result.epochs
+                << std::setw(12) << res.result.accuracy << std::setw(8) << res.result.milliseconds << std::endl;
+        }
+    }
+}
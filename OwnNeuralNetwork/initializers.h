@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cmath>
+
+// schemes for the random initial weights of a layer, all draw normally distributed weights with mean 0;
+// LeCun keeps the variance of the signals through linear or sigmoid-like layers, Xavier (Glorot) balances
+// it between the forward and the backward pass, He compensates the half of the signals ReLU cuts off
+namespace Initializers {
+    enum class Type {
+        LeCun,
+        Xavier,
+        He
+    };
+
+    std::string getName(Type _type) {
+        switch (_type) {
+        case Type::Xavier:
+            return "xavier";
+        case Type::He:
+            return "he";
+        default:
+            return "lecun";
+        }
+    }
+
+    // the inverse of getName, throws for an unknown name
+    Type getType(const std::string& _name) {
+        for (Type type : { Type::LeCun, Type::Xavier, Type::He }) {
+            if (getName(type) == _name) {
+                return type;
+            }
+        }
+        throw std::invalid_argument("Unknown initialization " + _name);
+    }
+
+    // standard deviation of the weights of a layer with _inputNodes incoming and _outputNodes outgoing links per node
+    template <typename Scalar>
+    Scalar getStandardDeviation(Type _type, size_t _inputNodes, size_t _outputNodes) {
+        switch (_type) {
+        case Type::Xavier:
+            return std::sqrt(Scalar(2) / static_cast<Scalar>(_inputNodes + _outputNodes));
+        case Type::He:
+            return std::sqrt(Scalar(2) / static_cast<Scalar>(_inputNodes));
+        default:
+            return std::pow(static_cast<Scalar>(_inputNodes), Scalar(-0.5));
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <random>
+#include <cmath>
+
+#include "nn_defs.h"
+#include "initializers.h"
+
+// a dense layer: outputs = activation(weights * inputs + bias),
+// the activation is a policy from activations.h chosen by the network
+template <typename Scalar = decimal>
+struct Layer {
+public:
+    Layer(size_t _inputNodes, size_t _outputNodes) :
+        weights(_outputNodes, _inputNodes),
+        bias(vector_t<Scalar>::Zero(_outputNodes))
+    {
+    }
+
+    // random weights with normally distributed entries, scaled by the number of links as _initialization requires
+    template <typename Generator>
+    void initializeWeights(Generator& _gen, Initializers::Type _initialization = Initializers::Type::LeCun) {
+        std::normal_distribution<Scalar> dist(Scalar(0), Initializers::getStandardDeviation<Scalar>(_initialization, getInputNodes(), getOutputNodes()));
+        weights = matrix_t<Scalar>::NullaryExpr(weights.rows(), weights.cols(), [&]() {return dist(_gen); });
+        bias.setZero();
+    }
+
+    // writes the signals emerging from this layer for the signals _inputs coming in into _outputs,
+    // which has to have the shape getOutputNodes() x _inputs.cols()
+    template <typename Activation>
+    void forward(const Eigen::Ref<const matrix_t<Scalar>>& _inputs, Eigen::Ref<matrix_t<Scalar>> _outputs) const {
+        _outputs.noalias() = weights * _inputs;
+        _outputs.colwise() += bias;
+        Activation::template forward<Scalar>(_outputs);
+    }
+
+    size_t getInputNodes() const {
+        return static_cast<size_t>(weights.cols());
+    }
+
+    size_t getOutputNodes() const {
+        return static_cast<size_t>(weights.rows());
+    }
+
+    matrix_t<Scalar> weights;
+    vector_t<Scalar> bias;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// read-only memory mapping of a whole file, the pages are loaded by the OS on access,
+// so reading a file through it does not need a buffer of the size of the file
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& _file) {
+        open(_file);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& _other) noexcept {
+        *this = std::move(_other);
+    }
+
+    MappedFile& operator=(MappedFile&& _other) noexcept {
+        if (this != &_other) {
+            close();
+            data = _other.data;
+            size = _other.size;
+#ifdef _WIN32
+            fileHandle = _other.fileHandle;
+            mappingHandle = _other.mappingHandle;
+            _other.fileHandle = INVALID_HANDLE_VALUE;
+            _other.mappingHandle = nullptr;
+#endif
+            _other.data = nullptr;
+            _other.size = 0;
+        }
+        return *this;
+    }
+
+    void open(const std::string& _file) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(_file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Could not open the file " + _file);
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(fileHandle, &fileSize);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) {
+            return;
+        }
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle == nullptr) {
+            close();
+            throw std::runtime_error("Could not map the file " + _file);
+        }
+        data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = ::open(_file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open the file " + _file);
+        }
+        struct stat fileStat;
+        fstat(fd, &fileStat);
+        size = static_cast<size_t>(fileStat.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        if (data != nullptr) {
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+#endif
+        if (data == nullptr) {
+            close();
+            throw std::runtime_error("Could not map the file " + _file);
+        }
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    std::string_view getContent() const {
+        return data == nullptr ? std::string_view() : std::string_view(data, size);
+    }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#endif
+};
@@ -5,14 +5,16 @@
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 #include "getcsvcontent.h"
 
-std::map<std::string, size_t> getMetaData(std::string _metaDataFile) {
+// the rows key,value of a metadata file, the values are kept as text
+std::map<std::string, std::string> getMetaData(std::string _metaDataFile) {
     std::vector<std::vector<std::string>> rawContent = getCsvContent(_metaDataFile);
-    std::map<std::string, size_t> metaData;
+    std::map<std::string, std::string> metaData;
     std::cout << std::endl;
-    std::for_each(rawContent.begin(), rawContent.end(), [&metaData](std::vector < std::string>& _x) {metaData.insert({ _x[0], std::stoul(_x[1]) }); });
+    std::for_each(rawContent.begin(), rawContent.end(), [&metaData](std::vector < std::string>& _x) {metaData.insert({ _x[0], _x.size() > 1 ? _x[1] : "" }); });
     return metaData;
 }
 
@@ -27,19 +29,45 @@ public:
         return firstLineToRead;
     }
 
+    char getDelimiter() const {
+        return delimiter;
+    }
+
+    size_t getNumberOfClasses() const {
+        return numberOfClasses;
+    }
+
+    // the values are numbers, except for the delimiter, which is the character itself (quoted for a comma: delimiter,",");
+    // delimiter and numberOfClasses are optional
     void setMetaData(const std::string& _file) {
-        std::map<std::string, size_t> metaData = getMetaData(_file);
-        targetColumn = metaData["targetColumn"];
-        firstLineToRead = metaData["firstLineToRead"];
+        std::map<std::string, std::string> metaData = getMetaData(_file);
+        auto number = [&metaData](const std::string& _key) -> size_t {
+            const auto it = metaData.find(_key);
+            return it == metaData.end() ? 0 : std::stoul(it->second);
+        };
+        targetColumn = number("targetColumn");
+        firstLineToRead = number("firstLineToRead");
+        numberOfClasses = number("numberOfClasses");
+        if (metaData.find("delimiter") != metaData.end()) {
+            if (metaData["delimiter"].size() != 1) {
+                throw std::invalid_argument("The delimiter has to be a single character");
+            }
+            delimiter = metaData["delimiter"].front();
+        }
         for (size_t j = 0; j < metaData.size(); ++j) {
             std::string key = "activeFeature" + std::to_string(j);
             if (metaData.find(key) == metaData.end())
                 continue;
-            activeFeatures.push_back(metaData[key]);
+            activeFeatures.push_back(number(key));
         }
     }
 
     size_t targetColumn;
     size_t firstLineToRead;
     std::vector<size_t> activeFeatures;
+    // the delimiter of the cells of the csv file
+    char delimiter = ',';
+    // the number of classes of the target column, 0 if it is only known once the whole file is read;
+    // DataTable counts the classes while reading, a CsvDataSource needs it up front
+    size_t numberOfClasses = 0;
 };
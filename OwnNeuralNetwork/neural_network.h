@@ -0,0 +1,393 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+#include "nn_defs.h"
+#include "helpers.h"
+#include "activations.h"
+#include "layer.h"
+#include "workspace.h"
+#include "optimizers.h"
+
+// Scalar is float or double, so one build can train in float and verify in double;
+// HiddenActivation is applied by all hidden layers, OutputActivation by the output layer,
+// both are policies from activations.h, so they are inlined into the forward and backward loops
+template <typename Scalar = decimal, typename HiddenActivation = Activations::Sigmoid, typename OutputActivation = Activations::Sigmoid>
+class NeuralNetwork {
+public:
+    using scalar_type = Scalar;
+    using vector_type = vector_t<Scalar>;
+    using matrix_type = matrix_t<Scalar>;
+    using output_activation = OutputActivation;
+    // samples per forward pass of the scoring calls, bounds the memory they keep
+    static constexpr Eigen::Index queryChunk = 256;
+
+    // _nodes holds the number of nodes of every layer, from the input layer to the output layer,
+    // e.g. { 4, 8, 8, 3 } builds a network with two hidden layers;
+    // the initial weights are drawn from a generator seeded with _seed, so a fixed seed reproduces the network
+    NeuralNetwork(const std::vector<size_t>& _nodes, Scalar _learningRate, uint64_t _seed = std::random_device{}(),
+        Initializers::Type _initialization = Initializers::Type::LeCun) :
+        learningRate{ _learningRate }
+    {
+        assert(_nodes.size() >= 2);
+        layers.reserve(_nodes.size() - 1);
+        for (size_t k = 1; k < _nodes.size(); ++k) {
+            layers.emplace_back(_nodes[k - 1], _nodes[k]);
+        }
+        initializeWeights(_seed, _initialization);
+    }
+
+    NeuralNetwork(size_t _inputNodes, size_t _hiddenNodes, size_t _outputNodes, Scalar _learningRate, uint64_t _seed = std::random_device{}(),
+        Initializers::Type _initialization = Initializers::Type::LeCun) :
+        NeuralNetwork({ _inputNodes, _hiddenNodes, _outputNodes }, _learningRate, _seed, _initialization)
+    {
+    }
+
+    // the biases start at zero
+    void initializeWeights(uint64_t _seed, Initializers::Type _initialization = Initializers::Type::LeCun) {
+        std::mt19937_64 gen{ _seed };
+        for (auto& layer : layers) {
+            layer.initializeWeights(gen, _initialization);
+        }
+    }
+
+    [[nodiscard]] vector_type query(const vector_type& _inputs) {
+        matrix_type outputs;
+        queryBatch(_inputs, outputs);
+        return outputs;
+    }
+
+    // scores a whole block of samples (columns = samples), in forward passes of up to queryChunk columns;
+    // _outputs is resized only if its shape does not match, so it can be reused across calls,
+    // _classIndices optionally receives the argmax output node of every sample
+    void queryBatch(const Eigen::Ref<const matrix_type>& _inputs, matrix_type& _outputs, std::vector<Eigen::Index>* _classIndices = nullptr) {
+        queryBatch(_inputs, _outputs, queryWorkspace, _classIndices);
+    }
+
+    // only the signal buffers of _workspace are used, so scoring does not grow the buffers of training
+    void queryBatch(const Eigen::Ref<const matrix_type>& _inputs, matrix_type& _outputs, Workspace<Scalar>& _workspace, std::vector<Eigen::Index>* _classIndices = nullptr) {
+        _outputs.resize(getOutputNodes(), _inputs.cols());
+        _workspace.reserveOutputs(layers, std::min(_inputs.cols(), queryChunk));
+        for (Eigen::Index begin = 0; begin < _inputs.cols(); begin += queryChunk) {
+            const Eigen::Index cols = std::min(queryChunk, _inputs.cols() - begin);
+            forward(_inputs.middleCols(begin, cols), _workspace);
+            _outputs.middleCols(begin, cols) = _workspace.outputs.back().leftCols(cols);
+        }
+
+        if (_classIndices == nullptr) {
+            return;
+        }
+        _classIndices->resize(_inputs.cols());
+        for (Eigen::Index j = 0; j < _outputs.cols(); ++j) {
+            _outputs.col(j).maxCoeff(&(*_classIndices)[j]);
+        }
+    }
+
+    [[nodiscard]] matrix_type queryBatch(const Eigen::Ref<const matrix_type>& _inputs, std::vector<Eigen::Index>* _classIndices = nullptr) {
+        matrix_type outputs(getOutputNodes(), _inputs.cols());
+        queryBatch(_inputs, outputs, _classIndices);
+        return outputs;
+    }
+
+    void train(const vector_type& _inputs, const vector_type& _targets) {
+        trainBatch(_inputs, _targets);
+    }
+
+    // trains a whole mini-batch at once, each column of _inputs/_targets is one sample;
+    // the weight updates of all samples are accumulated and applied once (averaged over the batch)
+    void trainBatch(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets) {
+        trainBatch(_inputs, _targets, workspace);
+    }
+
+    // once _workspace has grown to the batch size, a training step reuses its buffers (checked by ReallocationGuard)
+    void trainBatch(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets, Workspace<Scalar>& _workspace) {
+        assert(_inputs.cols() == _targets.cols());
+        const Eigen::Index batchSize = _inputs.cols();
+        if (batchSize == 0) {
+            return;
+        }
+        _workspace.reserve(layers, batchSize);
+        ReallocationGuard guard(_workspace);
+
+        computeGradients(_inputs, _targets, _workspace);
+        applyGradients(_workspace, batchSize);
+    }
+
+    // trains a mini-batch on the class labels of its samples instead of encoded targets, no one-hot matrix is needed;
+    // only for an output policy with a fused loss such as Activations::SoftmaxCrossEntropy, whose output errors are
+    // the one-hot targets minus the probabilities
+    void trainBatch(const Eigen::Ref<const matrix_type>& _inputs, std::span<const uint32_t> _labels) {
+        trainBatch(_inputs, _labels, workspace);
+    }
+
+    void trainBatch(const Eigen::Ref<const matrix_type>& _inputs, std::span<const uint32_t> _labels, Workspace<Scalar>& _workspace) {
+        static_assert(Activations::hasFusedLoss<OutputActivation>, "training on labels needs an output activation with a fused loss");
+        assert(static_cast<size_t>(_inputs.cols()) == _labels.size());
+        const Eigen::Index batchSize = _inputs.cols();
+        if (batchSize == 0) {
+            return;
+        }
+        _workspace.reserve(layers, batchSize);
+        ReallocationGuard guard(_workspace);
+
+        forward(_inputs, _workspace);
+        auto finalDeltas = _workspace.deltas.back().leftCols(batchSize);
+        finalDeltas.noalias() = -_workspace.outputs.back().leftCols(batchSize);
+        for (Eigen::Index j = 0; j < batchSize; ++j) {
+            assert(_labels[j] < getOutputNodes() && "class label without an output node");
+            finalDeltas(_labels[j], j) += Scalar(1);
+        }
+        backward(_inputs, _workspace);
+        applyGradients(_workspace, batchSize);
+    }
+
+    // summed cross-entropy of the class labels _labels under the outputs for _inputs, computed from the logits of the
+    // output layer with log-sum-exp, so it stays finite for confident wrong predictions; needs a fused loss as above
+    Scalar getCrossEntropy(const Eigen::Ref<const matrix_type>& _inputs, std::span<const uint32_t> _labels) {
+        static_assert(Activations::hasFusedLoss<OutputActivation>, "the cross-entropy needs an output activation with a fused loss");
+        assert(static_cast<size_t>(_inputs.cols()) == _labels.size());
+        assert(std::all_of(_labels.begin(), _labels.end(), [this](uint32_t _label) { return _label < getOutputNodes(); }));
+        queryWorkspace.reserveOutputs(layers, std::min(_inputs.cols(), queryChunk));
+        Scalar res = 0;
+        for (Eigen::Index begin = 0; begin < _inputs.cols(); begin += queryChunk) {
+            const Eigen::Index cols = std::min(queryChunk, _inputs.cols() - begin);
+            const auto inputs = _inputs.middleCols(begin, cols);
+            // the hidden layers as in forward, the output layer without its activation
+            const size_t last = layers.size() - 1;
+            auto logits = queryWorkspace.outputs[last].leftCols(cols);
+            if (last == 0) {
+                layers[last].template forward<Activations::Identity>(inputs, logits);
+            }
+            else {
+                forwardLayer(0, inputs, queryWorkspace.outputs.front().leftCols(cols));
+                for (size_t k = 1; k < last; ++k) {
+                    forwardLayer(k, queryWorkspace.outputs[k - 1].leftCols(cols), queryWorkspace.outputs[k].leftCols(cols));
+                }
+                layers[last].template forward<Activations::Identity>(queryWorkspace.outputs[last - 1].leftCols(cols), logits);
+            }
+            res += Helpers::getCrossEntropy<Scalar>(logits, _labels.subspan(static_cast<size_t>(begin), static_cast<size_t>(cols)));
+        }
+        return res;
+    }
+
+    // data-parallel variant of trainBatch: the batch is split into one contiguous chunk per workspace,
+    // every thread computes the gradients of its chunk into its own workspace, the gradients are then
+    // summed up by a pairwise tree reduction in a fixed order, so the result only depends on the
+    // number of workspaces and not on the scheduling of the threads
+    void trainBatchParallel(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets, std::vector<Workspace<Scalar>>& _workspaces) {
+        assert(_inputs.cols() == _targets.cols());
+        assert(!_workspaces.empty());
+        const Eigen::Index batchSize = _inputs.cols();
+        if (batchSize == 0) {
+            return;
+        }
+        const int threads = static_cast<int>(_workspaces.size());
+        const Eigen::Index chunkSize = (batchSize + threads - 1) / threads;
+        for (auto& workspace : _workspaces) {
+            workspace.reserve(layers, chunkSize);
+        }
+
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (int t = 0; t < threads; ++t) {
+            const Eigen::Index begin = std::min(batchSize, t * chunkSize);
+            const Eigen::Index cols = std::min(chunkSize, batchSize - begin);
+            ReallocationGuard guard(_workspaces[t]);
+            computeGradients(_inputs.middleCols(begin, cols), _targets.middleCols(begin, cols), _workspaces[t]);
+        }
+
+        for (int stride = 1; stride < threads; stride *= 2) {
+#pragma omp parallel for num_threads(threads) schedule(static)
+            for (int t = 0; t < threads - stride; t += 2 * stride) {
+                for (size_t k = 0; k < layers.size(); ++k) {
+                    _workspaces[t].weightGradients[k] += _workspaces[t + stride].weightGradients[k];
+                    _workspaces[t].biasGradients[k] += _workspaces[t + stride].biasGradients[k];
+                }
+            }
+        }
+
+        applyGradients(_workspaces.front(), batchSize);
+    }
+
+    // trainBatchParallel on _threads threads with workspaces owned by the network
+    void trainBatchParallel(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets, size_t _threads) {
+        threadWorkspaces.resize(std::max<size_t>(_threads, 1));
+        trainBatchParallel(_inputs, _targets, threadWorkspaces);
+    }
+
+    // Hogwild-style asynchronous SGD (opt-in): _threads workers pull the next _batchSize sample indices
+    // of _order from a shared atomic cursor, compute the gradients on their own workspace and apply them
+    // to the shared weights without any locking; the updates of different threads may interleave,
+    // so runs are not reproducible, in exchange the threads never wait for each other;
+    // the moments of a stateful optimizer are shared by the threads in the same way as the weights, only its step counter is atomic
+    void trainHogwild(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets, const std::vector<Eigen::Index>& _order, size_t _threads, Eigen::Index _batchSize = 1) {
+        assert(_inputs.cols() == _targets.cols());
+        const int threads = static_cast<int>(std::max<size_t>(_threads, 1));
+        const Eigen::Index samples = static_cast<Eigen::Index>(_order.size());
+        _batchSize = std::max<Eigen::Index>(_batchSize, 1);
+        threadWorkspaces.resize(threads);
+        for (auto& workspace : threadWorkspaces) {
+            workspace.reserve(layers, _batchSize);
+        }
+        std::atomic<Eigen::Index> cursor{ 0 };
+
+#pragma omp parallel num_threads(threads)
+        {
+#ifdef _OPENMP
+            Workspace<Scalar>& workspace = threadWorkspaces[omp_get_thread_num()];
+#else
+            Workspace<Scalar>& workspace = threadWorkspaces.front();
+#endif
+            // the samples of a batch are gathered into thread-local contiguous buffers
+            matrix_type batchInputs(_inputs.rows(), _batchSize);
+            matrix_type batchTargets(_targets.rows(), _batchSize);
+            for (Eigen::Index begin = cursor.fetch_add(_batchSize); begin < samples; begin = cursor.fetch_add(_batchSize)) {
+                const Eigen::Index cols = std::min(_batchSize, samples - begin);
+                for (Eigen::Index j = 0; j < cols; ++j) {
+                    batchInputs.col(j) = _inputs.col(_order[begin + j]);
+                    batchTargets.col(j) = _targets.col(_order[begin + j]);
+                }
+                ReallocationGuard guard(workspace);
+                computeGradients(batchInputs.leftCols(cols), batchTargets.leftCols(cols), workspace);
+                applyGradients(workspace, cols);
+            }
+        }
+    }
+
+    // the learning rate of the next training steps, e.g. set by a schedule before every mini-batch
+    void setLearningRate(Scalar _learningRate) {
+        learningRate = _learningRate;
+    }
+
+    Scalar getLearningRate() const {
+        return learningRate;
+    }
+
+    // replaces the update rule, the state of the new one starts at zero; plain SGD by default
+    void setOptimizer(const Optimizers::Settings& _settings) {
+        optimizer = Optimizers::Optimizer<Scalar>(_settings, layers);
+    }
+
+    // clears the state of the update rule, e.g. at a warm restart of the learning rate schedule
+    void resetOptimizer() {
+        optimizer.reset();
+    }
+
+    [[nodiscard]] const Optimizers::Optimizer<Scalar>& getOptimizer() const {
+        return optimizer;
+    }
+
+    // the buffers of the single-threaded training and query calls
+    [[nodiscard]] const Workspace<Scalar>& getWorkspace() const {
+        return workspace;
+    }
+
+    [[nodiscard]] const std::vector<Layer<Scalar>>& getLayers() const {
+        return layers;
+    }
+
+    // copies the weights and biases of _layers into the network, e.g. from a checkpoint;
+    // the shapes have to match, so no memory is allocated
+    void setLayers(const std::vector<Layer<Scalar>>& _layers) {
+        assert(_layers.size() == layers.size());
+        for (size_t k = 0; k < layers.size(); ++k) {
+            assert(_layers[k].weights.rows() == layers[k].weights.rows() && _layers[k].weights.cols() == layers[k].weights.cols());
+            layers[k].weights = _layers[k].weights;
+            layers[k].bias = _layers[k].bias;
+        }
+    }
+
+    size_t getInputNodes() const {
+        return layers.front().getInputNodes();
+    }
+
+    size_t getOutputNodes() const {
+        return layers.back().getOutputNodes();
+    }
+
+private:
+    // runs _inputs through all layers, the signals of every layer end up in _workspace.outputs
+    void forward(const Eigen::Ref<const matrix_type>& _inputs, Workspace<Scalar>& _workspace) const {
+        const Eigen::Index batchSize = _inputs.cols();
+        forwardLayer(0, _inputs, _workspace.outputs.front().leftCols(batchSize));
+        for (size_t k = 1; k < layers.size(); ++k) {
+            forwardLayer(k, _workspace.outputs[k - 1].leftCols(batchSize), _workspace.outputs[k].leftCols(batchSize));
+        }
+    }
+
+    void forwardLayer(size_t _k, const Eigen::Ref<const matrix_type>& _inputs, Eigen::Ref<matrix_type> _outputs) const {
+        if (_k + 1 == layers.size()) {
+            layers[_k].template forward<OutputActivation>(_inputs, _outputs);
+        }
+        else {
+            layers[_k].template forward<HiddenActivation>(_inputs, _outputs);
+        }
+    }
+
+    // runs _inputs forward and the errors backward, the gradients summed over all samples
+    // end up in _workspace.weightGradients and _workspace.biasGradients, the weights stay untouched
+    void computeGradients(const Eigen::Ref<const matrix_type>& _inputs, const Eigen::Ref<const matrix_type>& _targets, Workspace<Scalar>& _workspace) const {
+        const Eigen::Index batchSize = _inputs.cols();
+        if (batchSize == 0) {
+            for (size_t k = 0; k < layers.size(); ++k) {
+                _workspace.weightGradients[k].setZero();
+                _workspace.biasGradients[k].setZero();
+            }
+            return;
+        }
+
+        forward(_inputs, _workspace);
+
+        // output layer error is the (target - actual), scaled by the derivative of the output activation;
+        // with a fused loss it already is the gradient of the loss with respect to the signals into the layer
+        auto finalOutputs = _workspace.outputs.back().leftCols(batchSize);
+        auto finalDeltas = _workspace.deltas.back().leftCols(batchSize);
+        finalDeltas.noalias() = _targets - finalOutputs;
+        if constexpr (!Activations::hasFusedLoss<OutputActivation>) {
+            OutputActivation::template scaleByDerivative<Scalar>(finalOutputs, finalDeltas);
+        }
+        backward(_inputs, _workspace);
+    }
+
+    // propagates the output errors in _workspace.deltas back through all layers after a forward pass,
+    // the gradients summed over all samples end up in _workspace.weightGradients and _workspace.biasGradients
+    void backward(const Eigen::Ref<const matrix_type>& _inputs, Workspace<Scalar>& _workspace) const {
+        const Eigen::Index batchSize = _inputs.cols();
+        for (size_t k = layers.size(); k-- > 0;) {
+            auto deltas = _workspace.deltas[k].leftCols(batchSize);
+
+            // the error is split by the weights and recombined at the nodes of the previous layer
+            if (k > 0) {
+                auto previousOutputs = _workspace.outputs[k - 1].leftCols(batchSize);
+                auto previousDeltas = _workspace.deltas[k - 1].leftCols(batchSize);
+                previousDeltas.noalias() = layers[k].weights.transpose() * deltas;
+                HiddenActivation::template scaleByDerivative<Scalar>(previousOutputs, previousDeltas);
+                // one GEMM per weight matrix sums up the outer products of all samples
+                _workspace.weightGradients[k].noalias() = deltas * previousOutputs.transpose();
+            }
+            else {
+                _workspace.weightGradients[k].noalias() = deltas * _inputs.transpose();
+            }
+            _workspace.biasGradients[k].noalias() = deltas.rowwise().sum();
+        }
+    }
+
+    // _batchSize is the number of samples the gradients in _workspace are summed over
+    void applyGradients(const Workspace<Scalar>& _workspace, Eigen::Index _batchSize) {
+        optimizer.step(layers, _workspace, learningRate, _batchSize);
+    }
+
+    Scalar learningRate = 0;
+    std::vector<Layer<Scalar>> layers;
+    Optimizers::Optimizer<Scalar> optimizer;
+    // used by the overloads without an explicit workspace
+    Workspace<Scalar> workspace;
+    // signal buffers of queryBatch and getCrossEntropy, at most queryChunk columns wide
+    Workspace<Scalar> queryWorkspace;
+    std::vector<Workspace<Scalar>> threadWorkspaces;
+};
@@ -1,15 +1,15 @@
 #pragma once
 
-#define _DOUBLE_
+#include <limits>
+
+// the network, DataTable and Helpers are templates on the scalar type (float or double),
+// decimal is the default scalar type used where no other type is requested
+template <typename Scalar>
+using vector_t = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+template <typename Scalar>
+using matrix_t = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
 
-#ifndef _DOUBLE_
-using decimal = float;
-using vector_type = Eigen::VectorXf;
-using matrix_type = Eigen::MatrixXf;
-constexpr decimal decimal_eps = FLT_EPSILON;
-#else
 using decimal = double;
-using vector_type = Eigen::VectorXd;
-using matrix_type = Eigen::MatrixXd;
-constexpr decimal decimal_eps = DBL_EPSILON;
-#endif
\ No newline at end of file
+using vector_type = vector_t<decimal>;
+using matrix_type = matrix_t<decimal>;
+constexpr decimal decimal_eps = std::numeric_limits<decimal>::epsilon();
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cmath>
+#include <atomic>
+
+#include "nn_defs.h"
+#include "layer.h"
+#include "workspace.h"
+
+// update rules of NeuralNetwork, applied after the gradients of a mini-batch are summed up;
+// the gradients point downhill (they are built from target - output), so every rule adds its step to the weights
+namespace Optimizers {
+    enum class Type {
+        SGD,
+        Momentum,
+        Nesterov,
+        RMSProp,
+        Adam,
+        AdamW
+    };
+
+    std::string getName(Type _type) {
+        switch (_type) {
+        case Type::Momentum:
+            return "momentum";
+        case Type::Nesterov:
+            return "nesterov";
+        case Type::RMSProp:
+            return "rmsprop";
+        case Type::Adam:
+            return "adam";
+        case Type::AdamW:
+            return "adamw";
+        default:
+            return "sgd";
+        }
+    }
+
+    // the inverse of getName, throws for an unknown name
+    Type getType(const std::string& _name) {
+        for (Type type : { Type::SGD, Type::Momentum, Type::Nesterov, Type::RMSProp, Type::Adam, Type::AdamW }) {
+            if (getName(type) == _name) {
+                return type;
+            }
+        }
+        throw std::invalid_argument("Unknown optimizer " + _name);
+    }
+
+    struct Settings {
+        Type type = Type::SGD;
+        // decay of the velocity of Momentum and Nesterov
+        decimal momentum = 0.9;
+        // decay of the mean square of RMSProp
+        decimal rho = 0.9;
+        // decays of the first and second moment of Adam and AdamW
+        decimal beta1 = 0.9;
+        decimal beta2 = 0.999;
+        decimal epsilon = 1e-8;
+        // decoupled weight decay of AdamW, the biases are not decayed
+        decimal weightDecay = 0.01;
+    };
+
+    // the state of an update rule in buffers parallel to the layers: one matrix per weight matrix and
+    // one vector per bias vector for each of the (up to two) moments, allocated once for the layer shapes,
+    // so a step does not allocate memory.
+    // Every step updates each parameter tensor in place with Eigen array expressions over the raw buffers,
+    // which Eigen vectorizes itself (sqrt included), independent of compiler flags and OpenMP support.
+    // The step counter is atomic, so the Hogwild workers calling step concurrently count every step exactly once
+    template <typename Scalar = decimal>
+    class Optimizer {
+    public:
+        Optimizer() = default;
+
+        Optimizer(const Settings& _settings, const std::vector<Layer<Scalar>>& _layers) :
+            settings(_settings)
+        {
+            const size_t moments = getMoments();
+            firstWeights.resize(moments > 0 ? _layers.size() : 0);
+            firstBiases.resize(firstWeights.size());
+            secondWeights.resize(moments > 1 ? _layers.size() : 0);
+            secondBiases.resize(secondWeights.size());
+            for (size_t k = 0; k < firstWeights.size(); ++k) {
+                firstWeights[k] = matrix_t<Scalar>::Zero(_layers[k].weights.rows(), _layers[k].weights.cols());
+                firstBiases[k] = vector_t<Scalar>::Zero(_layers[k].bias.size());
+            }
+            for (size_t k = 0; k < secondWeights.size(); ++k) {
+                secondWeights[k] = matrix_t<Scalar>::Zero(_layers[k].weights.rows(), _layers[k].weights.cols());
+                secondBiases[k] = vector_t<Scalar>::Zero(_layers[k].bias.size());
+            }
+        }
+
+        Optimizer(const Optimizer& _other) :
+            settings(_other.settings),
+            steps(_other.steps.load()),
+            firstWeights(_other.firstWeights),
+            firstBiases(_other.firstBiases),
+            secondWeights(_other.secondWeights),
+            secondBiases(_other.secondBiases)
+        {
+        }
+
+        Optimizer& operator=(const Optimizer& _other) {
+            settings = _other.settings;
+            steps.store(_other.steps.load());
+            firstWeights = _other.firstWeights;
+            firstBiases = _other.firstBiases;
+            secondWeights = _other.secondWeights;
+            secondBiases = _other.secondBiases;
+            return *this;
+        }
+
+        // applies the gradients in _workspace, summed over _batchSize samples, with the learning rate _learningRate
+        void step(std::vector<Layer<Scalar>>& _layers, const Workspace<Scalar>& _workspace, Scalar _learningRate, Eigen::Index _batchSize) {
+            // the number of this step, counting from 1
+            const size_t step = steps.fetch_add(1, std::memory_order_relaxed) + 1;
+            for (size_t k = 0; k < _layers.size(); ++k) {
+                update(_layers[k].weights.data(), _workspace.weightGradients[k].data(), _layers[k].weights.size(), k, true, _learningRate, _batchSize, step);
+                update(_layers[k].bias.data(), _workspace.biasGradients[k].data(), _layers[k].bias.size(), k, false, _learningRate, _batchSize, step);
+            }
+        }
+
+        // clears the moments, e.g. before a warm restart
+        void reset() {
+            for (auto& moment : firstWeights) {
+                moment.setZero();
+            }
+            for (auto& moment : firstBiases) {
+                moment.setZero();
+            }
+            for (auto& moment : secondWeights) {
+                moment.setZero();
+            }
+            for (auto& moment : secondBiases) {
+                moment.setZero();
+            }
+            steps.store(0);
+        }
+
+        const Settings& getSettings() const {
+            return settings;
+        }
+
+    private:
+        size_t getMoments() const {
+            switch (settings.type) {
+            case Type::Momentum:
+            case Type::Nesterov:
+            case Type::RMSProp:
+                return 1;
+            case Type::Adam:
+            case Type::AdamW:
+                return 2;
+            default:
+                return 0;
+            }
+        }
+
+        using array_t = Eigen::Array<Scalar, Eigen::Dynamic, 1>;
+
+        // the update kernels, _w += step(_g) for the _n entries of parameter tensor _k in step _step
+        void update(Scalar* _w, const Scalar* _g, Eigen::Index _n, size_t _k, bool _isWeight, Scalar _learningRate, Eigen::Index _batchSize, size_t _step) {
+            Eigen::Map<array_t> w(_w, _n);
+            // the gradients are sums, the moments are kept of the mean gradient of the batch
+            const auto g = Scalar(1) / static_cast<Scalar>(_batchSize) * Eigen::Map<const array_t>(_g, _n);
+
+            switch (settings.type) {
+            case Type::Momentum: {
+                const Scalar mu = static_cast<Scalar>(settings.momentum);
+                Eigen::Map<array_t> m(getFirst(_k, _isWeight), _n);
+                m = mu * m + g;
+                w += _learningRate * m;
+                break;
+            }
+            case Type::Nesterov: {
+                // the step is taken from the look-ahead velocity mu * v + g
+                const Scalar mu = static_cast<Scalar>(settings.momentum);
+                Eigen::Map<array_t> m(getFirst(_k, _isWeight), _n);
+                m = mu * m + g;
+                w += _learningRate * (mu * m + g);
+                break;
+            }
+            case Type::RMSProp: {
+                const Scalar rho = static_cast<Scalar>(settings.rho);
+                const Scalar eps = static_cast<Scalar>(settings.epsilon);
+                Eigen::Map<array_t> m(getFirst(_k, _isWeight), _n);
+                m = rho * m + (Scalar(1) - rho) * g * g;
+                w += _learningRate * g / (m.sqrt() + eps);
+                break;
+            }
+            case Type::Adam:
+            case Type::AdamW: {
+                const Scalar beta1 = static_cast<Scalar>(settings.beta1);
+                const Scalar beta2 = static_cast<Scalar>(settings.beta2);
+                const Scalar eps = static_cast<Scalar>(settings.epsilon);
+                // the bias corrections of both moments are folded into the step size and epsilon
+                const Scalar correction1 = Scalar(1) - std::pow(beta1, static_cast<Scalar>(_step));
+                const Scalar correction2 = Scalar(1) - std::pow(beta2, static_cast<Scalar>(_step));
+                const Scalar rate = _learningRate * std::sqrt(correction2) / correction1;
+                const Scalar epsHat = eps * std::sqrt(correction2);
+                const Scalar decay = settings.type == Type::AdamW && _isWeight ? Scalar(1) - _learningRate * static_cast<Scalar>(settings.weightDecay) : Scalar(1);
+                Eigen::Map<array_t> m(getFirst(_k, _isWeight), _n);
+                Eigen::Map<array_t> v(_isWeight ? secondWeights[_k].data() : secondBiases[_k].data(), _n);
+                m = beta1 * m + (Scalar(1) - beta1) * g;
+                v = beta2 * v + (Scalar(1) - beta2) * g * g;
+                w = decay * w + rate * m / (v.sqrt() + epsHat);
+                break;
+            }
+            default: {
+                // plain SGD, the same update as before the optimizers existed
+                const Scalar rate = _learningRate / static_cast<Scalar>(_batchSize);
+                w += rate * Eigen::Map<const array_t>(_g, _n);
+                break;
+            }
+            }
+        }
+
+        // the buffer of the first moment of parameter tensor _k
+        Scalar* getFirst(size_t _k, bool _isWeight) {
+            return _isWeight ? firstWeights[_k].data() : firstBiases[_k].data();
+        }
+
+        Settings settings;
+        std::atomic<size_t> steps{ 0 };
+        std::vector<matrix_t<Scalar>> firstWeights;
+        std::vector<vector_t<Scalar>> firstBiases;
+        std::vector<matrix_t<Scalar>> secondWeights;
+        std::vector<vector_t<Scalar>> secondBiases;
+    };
+}
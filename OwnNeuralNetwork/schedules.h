@@ -0,0 +1,174 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+
+#include "nn_defs.h"
+
+// learning rate schedules of the epoch loops; a schedule counts either mini-batches or epochs, depending on
+// its unit, and gives the learning rate for the next mini-batch, so it is chosen at runtime like the optimizer
+namespace Schedules {
+    enum class Type {
+        Constant,
+        Step,
+        Exponential,
+        CosineWarmRestarts,
+        OneCycle,
+        ReduceOnPlateau
+    };
+
+    enum class Unit {
+        Step,
+        Epoch
+    };
+
+    std::string getName(Type _type) {
+        switch (_type) {
+        case Type::Step:
+            return "step";
+        case Type::Exponential:
+            return "exponential";
+        case Type::CosineWarmRestarts:
+            return "cosine";
+        case Type::OneCycle:
+            return "onecycle";
+        case Type::ReduceOnPlateau:
+            return "plateau";
+        default:
+            return "constant";
+        }
+    }
+
+    // the inverse of getName, throws for an unknown name
+    Type getType(const std::string& _name) {
+        for (Type type : { Type::Constant, Type::Step, Type::Exponential, Type::CosineWarmRestarts, Type::OneCycle, Type::ReduceOnPlateau }) {
+            if (getName(type) == _name) {
+                return type;
+            }
+        }
+        throw std::invalid_argument("Unknown schedule " + _name);
+    }
+
+    // the lengths are counted in the unit of the schedule
+    struct Settings {
+        Type type = Type::Constant;
+        Unit unit = Unit::Epoch;
+        // Step: the rate is multiplied by gamma every stepSize units; Exponential: by gamma every unit
+        size_t stepSize = 30;
+        decimal gamma = 0.95;
+        // CosineWarmRestarts: the rate falls from the base rate to minRate in period units,
+        // then restarts at the base rate with a period longer by periodMultiplier
+        size_t period = 20;
+        decimal periodMultiplier = 2.0;
+        decimal minRate = 0.0;
+        // OneCycle: over all units of the run, the rate rises from base / divFactor to the base rate
+        // in the first warmUp share and falls to base / (divFactor * finalDivFactor) in the rest
+        decimal warmUp = 0.3;
+        decimal divFactor = 25.0;
+        decimal finalDivFactor = 1e4;
+        // ReduceOnPlateau: the rate is multiplied by factor after plateauPatience epochs without improvement,
+        // the same improvement that resets the patience of early stopping, so plateauPatience should be smaller
+        // than the early stopping patience; never below minRate
+        size_t plateauPatience = 5;
+        decimal factor = 0.5;
+    };
+
+    class Schedule {
+    public:
+        // _baseRate is the learning rate of the network, _steps the mini-batches per epoch and _epochs the length of the run
+        Schedule(const Settings& _settings, decimal _baseRate, size_t _steps, size_t _epochs) :
+            settings(_settings),
+            baseRate(_baseRate),
+            rate(_baseRate),
+            units(std::max<size_t>(settings.unit == Unit::Step ? _steps * _epochs : _epochs, 1)),
+            period(std::max<size_t>(settings.period, 1))
+        {
+            update();
+        }
+
+        // the learning rate of the next mini-batch
+        decimal getRate() const {
+            return rate;
+        }
+
+        // after every mini-batch; true at a warm restart
+        bool onStep() {
+            return settings.unit == Unit::Step && advance();
+        }
+
+        // after every epoch, _improved as decided by the early stopping; true at a warm restart
+        bool onEpoch(bool _improved) {
+            if (settings.type == Type::ReduceOnPlateau) {
+                plateau = _improved ? 0 : plateau + 1;
+                if (plateau >= std::max<size_t>(settings.plateauPatience, 1)) {
+                    plateau = 0;
+                    rate = std::max(rate * settings.factor, settings.minRate);
+                }
+                return false;
+            }
+            return settings.unit == Unit::Epoch && advance();
+        }
+
+        const Settings& getSettings() const {
+            return settings;
+        }
+
+    private:
+        bool advance() {
+            ++position;
+            bool restarted = false;
+            if (settings.type == Type::CosineWarmRestarts && position - cycleStart >= period) {
+                cycleStart = position;
+                period = std::max<size_t>(static_cast<size_t>(std::round(static_cast<decimal>(period) * settings.periodMultiplier)), 1);
+                restarted = true;
+            }
+            update();
+            return restarted;
+        }
+
+        void update() {
+            const decimal t = static_cast<decimal>(position);
+            switch (settings.type) {
+            case Type::Step:
+                rate = baseRate * std::pow(settings.gamma, static_cast<decimal>(position / std::max<size_t>(settings.stepSize, 1)));
+                break;
+            case Type::Exponential:
+                rate = baseRate * std::pow(settings.gamma, t);
+                break;
+            case Type::CosineWarmRestarts:
+                rate = settings.minRate + 0.5 * (baseRate - settings.minRate)
+                    * (1.0 + std::cos(std::numbers::pi * static_cast<decimal>(position - cycleStart) / static_cast<decimal>(period)));
+                break;
+            case Type::OneCycle: {
+                const decimal initialRate = baseRate / settings.divFactor;
+                const decimal finalRate = initialRate / settings.finalDivFactor;
+                const decimal warmUpUnits = std::max(settings.warmUp * static_cast<decimal>(units), 1.0);
+                // cosine interpolation from _from to _to over _x in [0, 1]
+                auto anneal = [](decimal _from, decimal _to, decimal _x) {
+                    return _to + 0.5 * (_from - _to) * (1.0 + std::cos(std::numbers::pi * std::min(_x, 1.0)));
+                };
+                rate = t < warmUpUnits ? anneal(initialRate, baseRate, t / warmUpUnits)
+                    : anneal(baseRate, finalRate, (t - warmUpUnits) / std::max(static_cast<decimal>(units) - warmUpUnits, 1.0));
+                break;
+            }
+            default:
+                // Constant and ReduceOnPlateau change the rate only in onEpoch
+                break;
+            }
+        }
+
+        Settings settings;
+        decimal baseRate;
+        decimal rate;
+        size_t units;
+        size_t position = 0;
+        // CosineWarmRestarts: start and length of the current cycle
+        size_t cycleStart = 0;
+        size_t period;
+        // ReduceOnPlateau: epochs without improvement
+        size_t plateau = 0;
+    };
+}
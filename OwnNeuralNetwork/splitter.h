@@ -4,6 +4,10 @@
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <iterator>
+#include <random>
+#include <span>
+#include <cstdint>
 
 struct Splitter {
 public:
@@ -38,29 +42,130 @@ public:
         std::sort(idcs.second.begin(), idcs.second.end());
     }
 
-    void pickIdcsForCrossValidation(size_t _fold, size_t _sections = 1) {
-        size_t m = cnt / _sections;
-        size_t n = m / _fold;
-        idcs.second.resize(0);
-        for (size_t i = 0; i < _sections; ++i) {
-            for (size_t j = 0; j < _fold; ++j) {
+    // stratified split into train (first) and test (second) indices: _testIdcs indices are picked so that every
+    // class keeps its share of _labels (largest remainder rounding), by a partial Fisher-Yates shuffle of the
+    // indices of each class; linear in the number of labels, both index lists come out sorted
+    void pickIdcsStratified(const std::vector<uint32_t>& _labels, size_t _testIdcs, uint64_t _seed) {
+        cnt = _labels.size();
+        _testIdcs = std::min(_testIdcs, cnt);
+        std::vector<size_t> offsets;
+        std::vector<size_t> byClass;
+        groupByClass(_labels, offsets, byClass);
+        const size_t classes = offsets.size() - 1;
+
+        // share of every class, the indices left by rounding down go to the largest remainders
+        std::vector<size_t> picks(classes);
+        std::vector<std::pair<size_t, size_t>> remainders(classes);
+        size_t assigned = 0;
+        for (size_t c = 0; c < classes; ++c) {
+            const size_t size = offsets[c + 1] - offsets[c];
+            picks[c] = size * _testIdcs / cnt;
+            remainders[c] = { size * _testIdcs % cnt, c };
+            assigned += picks[c];
+        }
+        std::sort(remainders.begin(), remainders.end(), [](const auto& _a, const auto& _b) { return _a.first > _b.first; });
+        for (size_t i = 0; assigned < _testIdcs; ++i, ++assigned) {
+            ++picks[remainders[i].second];
+        }
+
+        std::mt19937_64 gen{ _seed };
+        std::vector<char> isTest(cnt, 0);
+        for (size_t c = 0; c < classes; ++c) {
+            const size_t begin = offsets[c];
+            const size_t size = offsets[c + 1] - begin;
+            for (size_t i = 0; i < picks[c]; ++i) {
+                const size_t j = std::uniform_int_distribution<size_t>(i, size - 1)(gen);
+                std::swap(byClass[begin + i], byClass[begin + j]);
+                isTest[byClass[begin + i]] = 1;
+            }
+        }
+
+        idcs.first.clear();
+        idcs.second.clear();
+        idcs.first.reserve(cnt - _testIdcs);
+        idcs.second.reserve(_testIdcs);
+        for (size_t j = 0; j < cnt; ++j) {
+            (isTest[j] ? idcs.second : idcs.first).push_back(j);
+        }
+    }
+
+    // stratified k-fold: the indices of every class are shuffled and dealt to the _folds folds in turn, so every fold
+    // keeps the class shares of _labels and the fold sizes differ by at most one; linear in the number of labels.
+    // The folds are read with getFoldIdcs/getTrainIdcsOfFold or selected as test part with selectFold
+    void pickIdcsForCrossValidation(const std::vector<uint32_t>& _labels, size_t _folds, uint64_t _seed) {
+        cnt = _labels.size();
+        _folds = std::max<size_t>(_folds, 1);
+        std::vector<size_t> offsets;
+        std::vector<size_t> byClass;
+        groupByClass(_labels, offsets, byClass);
 
+        std::mt19937_64 gen{ _seed };
+        std::vector<uint32_t> foldOf(cnt);
+        size_t dealt = 0;
+        for (size_t c = 0; c + 1 < offsets.size(); ++c) {
+            for (size_t i = offsets[c]; i < offsets[c + 1]; ++i, ++dealt) {
+                const size_t j = std::uniform_int_distribution<size_t>(i, offsets[c + 1] - 1)(gen);
+                std::swap(byClass[i], byClass[j]);
+                foldOf[byClass[i]] = static_cast<uint32_t>(dealt % _folds);
             }
         }
 
+        foldIdcs.assign(_folds, {});
+        for (auto& fold : foldIdcs) {
+            fold.reserve(cnt / _folds + 1);
+        }
+        for (size_t j = 0; j < cnt; ++j) {
+            foldIdcs[foldOf[j]].push_back(j);
+        }
+    }
+
+    size_t getFolds() const {
+        return foldIdcs.size();
+    }
+
+    // the sorted indices of fold _fold
+    std::span<const size_t> getFoldIdcs(size_t _fold) const {
+        return foldIdcs[_fold];
     }
 
+    // the sorted indices of all folds but _fold
+    std::vector<size_t> getTrainIdcsOfFold(size_t _fold) const {
+        std::vector<char> inFold(cnt, 0);
+        for (size_t j : foldIdcs[_fold]) {
+            inFold[j] = 1;
+        }
+        std::vector<size_t> res;
+        res.reserve(cnt - foldIdcs[_fold].size());
+        for (size_t j = 0; j < cnt; ++j) {
+            if (!inFold[j]) {
+                res.push_back(j);
+            }
+        }
+        return res;
+    }
+
+    // fold _fold becomes the test part, all others the train part
+    void selectFold(size_t _fold) {
+        idcs.first = getTrainIdcsOfFold(_fold);
+        idcs.second = foldIdcs[_fold];
+    }
+
+    // the train indices are all indices not picked for the test part, linear with a mask instead of erasing
     void removeIdcs() {
         if (idcs.second.size() == 0) {
             return;
         }
-        resetIdcsFirst();
-        for (auto it = idcs.second.cbegin(); it != idcs.second.cend(); ++it) {
-            auto found = std::find(idcs.first.begin(), idcs.first.end(), *it);
-            if (found == idcs.first.end()) {
-                continue;
+        std::vector<char> picked(cnt, 0);
+        for (size_t j : idcs.second) {
+            if (j < cnt) {
+                picked[j] = 1;
+            }
+        }
+        idcs.first.clear();
+        for (size_t j = 0; j < cnt; ++j) {
+            if (!picked[j]) {
+                idcs.first.push_back(j);
             }
-            idcs.first.erase(found);
         }
     }
 
@@ -80,7 +185,34 @@ public:
         return idcs;
     }
 
+    const std::pair< std::vector<size_t>, std::vector<size_t>>& getIdcs() const {
+        return idcs;
+    }
+
+    std::span<const size_t> getTrainIdcs() const {
+        return idcs.first;
+    }
+
+    std::span<const size_t> getTestIdcs() const {
+        return idcs.second;
+    }
+
 private:
+    // counting sort of the indices by label, the indices of class c are byClass[offsets[c]] ... byClass[offsets[c + 1] - 1]
+    static void groupByClass(const std::vector<uint32_t>& _labels, std::vector<size_t>& _offsets, std::vector<size_t>& _byClass) {
+        const size_t classes = _labels.empty() ? 0 : static_cast<size_t>(*std::max_element(_labels.begin(), _labels.end())) + 1;
+        _offsets.assign(classes + 1, 0);
+        for (uint32_t label : _labels) {
+            ++_offsets[label + 1];
+        }
+        std::partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+        _byClass.resize(_labels.size());
+        std::vector<size_t> next(_offsets.begin(), _offsets.end() - 1);
+        for (size_t j = 0; j < _labels.size(); ++j) {
+            _byClass[next[_labels[j]]++] = j;
+        }
+    }
+
     void resetIdcsFirst() {
         idcs.first.resize(cnt);
         std::iota(std::begin(idcs.first), std::end(idcs.first), 0);
@@ -88,4 +220,5 @@ private:
 
     size_t cnt = 0;
     std::pair< std::vector<size_t>, std::vector<size_t>> idcs = std::make_pair< std::vector<size_t>, std::vector<size_t>>({}, {});
+    std::vector<std::vector<size_t>> foldIdcs;
 };
\ No newline at end of file
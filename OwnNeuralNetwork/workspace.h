@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "nn_defs.h"
+#include "layer.h"
+
+// buffers of one forward/backward pass through a layer stack;
+// every thread working on a network needs its own workspace
+template <typename Scalar = decimal>
+struct Workspace {
+public:
+    // makes room for batches of up to _batchSize samples, smaller batches use the leftmost columns,
+    // so memory is only allocated when the capacity grows (counted in reallocations)
+    void reserve(const std::vector<Layer<Scalar>>& _layers, Eigen::Index _batchSize) {
+        if (outputs.size() == _layers.size() && _batchSize <= capacity) {
+            return;
+        }
+        capacity = std::max(capacity, _batchSize);
+        outputs.resize(_layers.size());
+        deltas.resize(_layers.size());
+        weightGradients.resize(_layers.size());
+        biasGradients.resize(_layers.size());
+        for (size_t k = 0; k < _layers.size(); ++k) {
+            outputs[k].resize(_layers[k].getOutputNodes(), capacity);
+            deltas[k].resize(_layers[k].getOutputNodes(), capacity);
+            weightGradients[k].resize(_layers[k].weights.rows(), _layers[k].weights.cols());
+            biasGradients[k].resize(_layers[k].bias.size());
+        }
+        ++reallocations;
+    }
+
+    // makes room for the signals of a forward pass of up to _batchSize samples only, for scoring;
+    // the deltas and gradients of training are not allocated
+    void reserveOutputs(const std::vector<Layer<Scalar>>& _layers, Eigen::Index _batchSize) {
+        if (outputs.size() == _layers.size() && !outputs.empty() && _batchSize <= outputs.front().cols()) {
+            return;
+        }
+        outputs.resize(_layers.size());
+        for (size_t k = 0; k < _layers.size(); ++k) {
+            outputs[k].resize(_layers[k].getOutputNodes(), std::max(capacity, _batchSize));
+        }
+        ++reallocations;
+    }
+
+    Eigen::Index getCapacity() const {
+        return capacity;
+    }
+
+    size_t getReallocations() const {
+        return reallocations;
+    }
+
+    // signals emerging from every layer in the last forward pass
+    std::vector<matrix_t<Scalar>> outputs;
+    // error signals at the inputs of every activation, filled by the backward pass
+    std::vector<matrix_t<Scalar>> deltas;
+    // weight and bias updates of every layer, summed over all samples of the batch
+    std::vector<matrix_t<Scalar>> weightGradients;
+    std::vector<vector_t<Scalar>> biasGradients;
+
+private:
+    Eigen::Index capacity = 0;
+    size_t reallocations = 0;
+};
+
+// checks in debug builds that a training step gets by with the buffers _workspace already has:
+// the workspace must not grow while the guard is alive. A guard only watches its own workspace, so the
+// guards of threads working on different workspaces do not interfere with each other.
+// This covers the buffers of the network, not Eigen's internals: a large matrix product still takes its
+// blocking buffers from the heap once they exceed EIGEN_STACK_ALLOCATION_LIMIT
+template <typename Scalar>
+class ReallocationGuard {
+public:
+    explicit ReallocationGuard(const Workspace<Scalar>& _workspace) :
+        workspace(_workspace),
+        reallocations(_workspace.getReallocations()),
+        capacity(_workspace.getCapacity())
+    {
+    }
+
+    ~ReallocationGuard() {
+        assert(workspace.getReallocations() == reallocations && "the workspace grew inside a training step");
+        assert(workspace.getCapacity() == capacity);
+    }
+
+    ReallocationGuard(const ReallocationGuard&) = delete;
+    ReallocationGuard& operator=(const ReallocationGuard&) = delete;
+
+private:
+    const Workspace<Scalar>& workspace;
+    size_t reallocations;
+    Eigen::Index capacity;
+};